@@ -0,0 +1,31 @@
+# Standalone micro benchmarks, not part of ShowBoard.pro (a lib project),
+#  build after it, same as rasterizer:
+#   qmake benchmark/benchmark.pro SHOWBOARD_LIBDIR=<dir of ShowBoard lib> && make
+
+QT += core
+
+TEMPLATE = app
+TARGET = showboardbench
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+include($$(applyCommonConfig))
+include($$(applyConanPlugin))
+
+include(../../config.pri)
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/..
+
+isEmpty(SHOWBOARD_LIBDIR): SHOWBOARD_LIBDIR = $$(SHOWBOARD_LIBDIR)
+isEmpty(SHOWBOARD_LIBDIR): SHOWBOARD_LIBDIR = $$OUT_PWD/..
+
+LIBS += -L$$SHOWBOARD_LIBDIR -lShowBoard
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    oldlrucache.h
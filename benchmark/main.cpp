@@ -0,0 +1,271 @@
+/*
+ * showboardbench: micro benchmarks of ShowBoard internals, kept out of library
+ *
+ *  showboardbench [options] [benchmarks...]
+ *    lru                  get/put ops/s on full cache, about half misses,
+ *                         LRUCache against old QLinkedList/QMap cache; then
+ *                         hit ratio of each policy replaying access trace
+ *    -e, --entries <n>    cache entries of ops/s run (default: 10000,1000000)
+ *    -n, --ops <n>        ops of each run (default: 4194304)
+ *    -t, --trace <file>   access trace, lines of "key size" (default: synthetic)
+ *    -c, --capacity <n>   cache capacity of replay, 0 for 10% of trace bytes
+ *    decoder              StrokeDecoder points/s of each kernel up to best
+ *                         one of this cpu, on random points
+ *    -p, --points <n>     points of each decode (default: 1048576)
+ *
+ *  all benchmarks run when none is given
+ */
+
+#include "data/lrucache.h"
+#include "stroke/strokedecoder.h"
+#include "oldlrucache.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QtMath>
+#include <QDebug>
+
+struct Access
+{
+    uint key;
+    quint64 size;
+};
+
+class IntCache : public LRUCache<int, int>
+{
+public:
+    using LRUCache::LRUCache;
+
+protected:
+    virtual quint64 sizeOf(int const &) override { return 1; }
+
+    virtual bool destroy(int const &, int const &) override { return true; }
+};
+
+class OldIntCache : public OldLRUCache<int, int>
+{
+public:
+    using OldLRUCache::OldLRUCache;
+
+protected:
+    virtual quint64 sizeOf(int const &) override { return 1; }
+
+    virtual bool destroy(int const &, int const &) override { return true; }
+};
+
+class TraceCache : public LRUCache<uint, quint64>
+{
+public:
+    using LRUCache::LRUCache;
+
+protected:
+    virtual quint64 sizeOf(quint64 const & size) override { return size; }
+
+    virtual bool destroy(uint const &, quint64 const &) override { return true; }
+};
+
+// ops/s of get, each miss followed by put with eviction, cache full of entries
+template <typename Cache>
+static qreal run(int entries, int ops, int & hits)
+{
+    Cache cache(static_cast<quint64>(entries));
+    for (int i = 0; i < entries; ++i)
+        cache.put(i, i + 1); // 0 for miss
+    quint32 seed = 2463534242u;
+    int range = entries * 2;
+    hits = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ops; ++i) {
+        // xorshift32, cheap compared to cache ops
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        int k = static_cast<int>(seed % static_cast<quint32>(range));
+        if (cache.get(k)) {
+            ++hits;
+        } else {
+            cache.put(k, k + 1);
+        }
+    }
+    qint64 elapsed = qMax<qint64>(timer.nsecsElapsed(), 1);
+    return static_cast<qreal>(ops) * 1000000000 / elapsed;
+}
+
+static bool loadTrace(QString const & fileName, QVector<Access> & trace)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        qWarning() << "open failed" << fileName << file.errorString();
+        return false;
+    }
+    QTextStream ts(&file);
+    Access a;
+    while (!ts.atEnd()) {
+        ts >> a.key >> a.size;
+        if (ts.status() != QTextStream::Ok)
+            break;
+        trace.append(a);
+        ts.skipWhiteSpace();
+    }
+    return !trace.isEmpty();
+}
+
+// skewed keys (log uniform) over keys, with sequential scans of cold keys in
+//  between, size fixed per key
+static QVector<Access> makeTrace(int keys, int count)
+{
+    QRandomGenerator random(1);
+    QVector<Access> trace;
+    trace.reserve(count);
+    uint cold = static_cast<uint>(keys);
+    while (trace.size() < count) {
+        if (random.bounded(100) == 0) {
+            for (int i = 0; i < keys / 20; ++i, ++cold)
+                trace.append({cold, 1 + (cold * 2654435761u >> 24) % 64});
+            continue;
+        }
+        uint key = static_cast<uint>(qPow(keys, random.generateDouble())) - 1;
+        trace.append({key, 1 + (key * 2654435761u >> 24) % 64});
+    }
+    trace.resize(count);
+    return trace;
+}
+
+static CacheStats replay(CachePolicy::Type policy, quint64 capacity, QVector<Access> const & trace)
+{
+    TraceCache cache(capacity, policy);
+    for (Access const & a : trace) {
+        if (cache.get(a.key) == 0)
+            cache.put(a.key, qMax<quint64>(a.size, 1));
+    }
+    return cache.stats();
+}
+
+static void benchLru(QCommandLineParser const & parser)
+{
+    int ops = parser.value("ops").toInt();
+    for (QString const & e : parser.value("entries").split(',')) {
+        int entries = e.toInt();
+        if (entries <= 0)
+            continue;
+        int hits = 0;
+        qreal opsps = run<IntCache>(entries, ops, hits);
+        int oldHits = 0;
+        qreal oldOpsps = run<OldIntCache>(entries, ops, oldHits);
+        qInfo().noquote() << QString("lru %1 entries: %2 ops/s, old %3 ops/s (%4x), %5% hits")
+                             .arg(entries)
+                             .arg(opsps, 0, 'f', 0)
+                             .arg(oldOpsps, 0, 'f', 0)
+                             .arg(opsps / oldOpsps, 0, 'f', 2)
+                             .arg(hits * 100.0 / qMax(ops, 1), 0, 'f', 1);
+    }
+
+    QVector<Access> trace;
+    if (parser.isSet("trace")) {
+        if (!loadTrace(parser.value("trace"), trace))
+            return;
+    } else {
+        trace = makeTrace(100000, 1 << 21);
+    }
+    quint64 capacity = parser.value("capacity").toULongLong();
+    if (capacity == 0) {
+        QHash<uint, quint64> sizes;
+        for (Access const & a : trace)
+            sizes.insert(a.key, qMax<quint64>(a.size, 1));
+        for (quint64 s : sizes)
+            capacity += s;
+        capacity = qMax<quint64>(capacity / 10, 1);
+    }
+    static char const * const names[] = {"lru", "2q", "w-tinylfu"};
+    for (CachePolicy::Type policy : {CachePolicy::Lru, CachePolicy::TwoQueue, CachePolicy::WTinyLfu}) {
+        CacheStats stats = replay(policy, capacity, trace);
+        qInfo().noquote() << QString("lru replay %1: %2 accesses, capacity %3, %4% hits")
+                             .arg(names[policy]).arg(trace.size()).arg(capacity)
+                             .arg(stats.hitRatio() * 100, 0, 'f', 2);
+    }
+}
+
+// decode count random points repeatly for 500 ms, return points per second
+static qreal decode(StrokeDecoder::Kernel kernel, QVector<StrokePoint> const & points)
+{
+    StrokeDecoder decoder(true, kernel);
+    StrokeDecoder::Block block;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 total = 0;
+    do {
+        decoder.reset(1, points[0].t);
+        decoder.decode(points.constData(), points.size(), block);
+        total += points.size();
+    } while (timer.elapsed() < 500);
+    return total * 1000.0 / timer.elapsed();
+}
+
+static void benchDecoder(QCommandLineParser const & parser)
+{
+    int count = parser.value("points").toInt();
+    if (count <= 0)
+        return;
+    QVector<StrokePoint> points(count);
+    QRandomGenerator random(static_cast<quint32>(count));
+    ushort t = 0;
+    for (StrokePoint & p : points) {
+        t += static_cast<ushort>(random.bounded(20));
+        p.t = t;
+        p.s = random.bounded(64) == 0;
+        p.p = static_cast<ushort>(random.bounded(0x8000));
+        p.x = static_cast<ushort>(random.bounded(0x10000));
+        p.y = static_cast<ushort>(random.bounded(0x10000));
+    }
+    static char const * const names[] = {"auto", "scalar", "sse2", "avx2"};
+    StrokeDecoder::Kernel best = StrokeDecoder::bestKernel();
+    qreal scalar = 0;
+    for (int k = StrokeDecoder::Scalar; k <= best; ++k) {
+        qreal pps = decode(static_cast<StrokeDecoder::Kernel>(k), points);
+        if (k == StrokeDecoder::Scalar)
+            scalar = pps;
+        qInfo().noquote() << QString("decoder %1: %2 points/s (%3x)")
+                             .arg(names[k])
+                             .arg(pps, 0, 'f', 0)
+                             .arg(pps / scalar, 0, 'f', 2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("showboardbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Micro benchmarks of ShowBoard internals");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"e", "entries"}, "Cache entries of lru ops/s runs, comma separated.", "n,...", "10000,1000000"},
+        {{"n", "ops"}, "Ops of each lru run.", "n", QString::number(1 << 22)},
+        {{"t", "trace"}, "Access trace of lru replay, lines of \"key size\".", "file"},
+        {{"c", "capacity"}, "Cache capacity of lru replay, 0 for 10% of trace bytes.", "n", "0"},
+        {{"p", "points"}, "Points of each decoder run.", "n", QString::number(1 << 20)},
+    });
+    parser.addPositionalArgument("benchmarks", "Benchmarks to run: lru, decoder.", "[benchmarks...]");
+    parser.process(app);
+
+    QStringList benchmarks = parser.positionalArguments();
+    if (benchmarks.isEmpty())
+        benchmarks = QStringList{"lru", "decoder"};
+    for (QString const & b : benchmarks) {
+        if (b == "lru") {
+            benchLru(parser);
+        } else if (b == "decoder") {
+            benchDecoder(parser);
+        } else {
+            qCritical() << "unknown benchmark" << b;
+            return 1;
+        }
+    }
+    return 0;
+}
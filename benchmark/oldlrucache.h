@@ -0,0 +1,76 @@
+#ifndef OLDLRUCACHE_H
+#define OLDLRUCACHE_H
+
+#include <QLinkedList>
+#include <QMap>
+
+/*
+ * LRUCache before intrusive nodes (QLinkedList ordered, QMap indexed), kept
+ *  here only as baseline of lru benchmark, put and get as they were
+ */
+
+template <typename K, typename V>
+class OldLRUCache
+{
+public:
+    OldLRUCache(quint64 capacity)
+        : size_(0)
+        , capacity_(capacity)
+    {
+    }
+
+    virtual ~OldLRUCache() {}
+
+public:
+    void put(K const & k, V const & v)
+    {
+        if (lruMap_.contains(k)) {
+            return;
+        }
+        lruList_.prepend(QPair<K, V>(k, v));
+        lruMap_.insert(k, lruList_.begin());
+        size_ += sizeOf(v);
+        QList<QPair<K, V>> rejects;
+        while (size_ > capacity_) {
+            QPair<K, V> & l = lruList_.back();
+            if (destroy(l.first, l.second)) {
+                size_ -= sizeOf(l.second);
+                lruMap_.remove(l.first);
+                lruList_.removeLast();
+                for (auto & r : rejects)
+                    lruList_.append(r);
+                rejects.clear();
+            } else {
+                rejects.prepend(lruList_.takeLast());
+            }
+        }
+    }
+
+    V get(K const & k)
+    {
+        auto iter = lruMap_.find(k);
+        if (iter == lruMap_.end()) {
+            return V();
+        }
+        typename QLinkedList<QPair<K, V>>::iterator & i = iter.value();
+        if (i != lruList_.begin()) {
+            lruList_.prepend(*i);
+            lruList_.erase(i);
+            i = lruList_.begin();
+        }
+        return i->second;
+    }
+
+protected:
+    virtual quint64 sizeOf(V const & v) = 0;
+
+    virtual bool destroy(K const & k, V const & v) = 0;
+
+private:
+    quint64 size_;
+    quint64 capacity_;
+    QLinkedList<QPair<K, V>> lruList_;
+    QMap<K, typename QLinkedList<QPair<K, V>>::iterator> lruMap_;
+};
+
+#endif // OLDLRUCACHE_H
@@ -130,6 +130,19 @@ QPromise<QByteArray> Resource::getData(QUrl const & url)
     return getData(nullptr, url);
 }
 
+QtPromise::QPromise<QSharedPointer<FileMapping>> Resource::mapData(QObject *context, const QUrl &url)
+{
+    DataProvider * provider = DataProvider::getProvider(url.scheme().toUtf8());
+    if (provider && provider->needCache()) {
+        QSharedPointer<FileMapping> mapping = cache_->mapData(url);
+        if (mapping)
+            return QPromise<QSharedPointer<FileMapping>>::resolve(mapping);
+    }
+    return getData(context, url).then([](QByteArray data) {
+        return QSharedPointer<FileMapping>(new FileMapping(data));
+    });
+}
+
 static QString fromMulticode(QByteArray const & bytes, QString const & charset);
 
 QtPromise::QPromise<QString> Resource::getText(QObject *context, const QUrl &url)
@@ -10,6 +10,7 @@
 
 class QNetworkAccessManager;
 class UrlFileCache;
+class FileMapping;
 
 /*
  * Resource is pure data, while ResourceView is struct data
@@ -59,6 +60,12 @@ public:
 
     static QtPromise::QPromise<QByteArray> getData(QUrl const & url);
 
+    /*
+     * get resource raw data, mapped without copy if it is cached file,
+     *  data is valid while mapping lives
+     */
+    static QtPromise::QPromise<QSharedPointer<FileMapping>> mapData(QObject * context, QUrl const & url);
+
     /*
      * get resource as text, decode by utf8
      */
@@ -0,0 +1,276 @@
+#include "cachejournal.h"
+#include "core/workthread.h"
+
+#include <QDataStream>
+#include <QSaveFile>
+#include <QHash>
+#include <QVector>
+#include <QDebug>
+
+#include <algorithm>
+
+static WorkThread& thread()
+{
+    static WorkThread th("CacheJournal");
+    return th;
+}
+
+static constexpr quint32 MAGIC_SNAPSHOT = 0x53424353; // SBCS
+static constexpr quint32 MAGIC_JOURNAL = 0x5342434a; // SBCJ
+static constexpr quint32 VERSION = 2;
+// hits flushed after this many
+static constexpr int BATCH = 256;
+
+enum Op : quint8
+{
+    Put = 1,
+    Access,
+    Update,
+    Evict,
+};
+
+CacheJournal::CacheJournal(const QString &prefix)
+    : prefix_(prefix)
+    , journal_(prefix + ".journal")
+{
+}
+
+CacheJournal::~CacheJournal()
+{
+    // posted flush holds this
+    if (thread().isRunning())
+        thread().sendWork([] () {});
+    flush();
+}
+
+bool CacheJournal::restore(QList<Entry> &entries)
+{
+    std::lock_guard<std::mutex> l(fileLock_);
+    int records = 0;
+    bool torn = false;
+    if (!replay(entries, records, torn))
+        return false;
+    entries_ = entries.size();
+    records_ = records;
+    // new records can't be appended after a torn one
+    if (torn || records_ > qMax(1024, entries_ * 2)) {
+        writeSnapshot(entries);
+        journal_.close();
+        QFile::remove(journal_.fileName());
+        records_ = 0;
+    }
+    return true;
+}
+
+void CacheJournal::reset(std::function<QList<Entry> ()> entries)
+{
+    // flushes wait for snapshot, their records are replayed on it
+    std::lock_guard<std::mutex> l(fileLock_);
+    QList<Entry> list = entries();
+    writeSnapshot(list);
+    journal_.close();
+    QFile::remove(journal_.fileName());
+    entries_ = list.size();
+    records_ = 0;
+}
+
+static QDataStream & operator<<(QDataStream & ds, CacheJournal::Entry const & e)
+{
+    return ds << e.path << e.size << e.hash << e.mtime << e.inode;
+}
+
+static QDataStream & operator>>(QDataStream & ds, CacheJournal::Entry & e)
+{
+    return ds >> e.path >> e.size >> e.hash >> e.mtime >> e.inode;
+}
+
+void CacheJournal::put(const Entry &entry)
+{
+    append(Put, entry);
+}
+
+void CacheJournal::access(const QString &path)
+{
+    append(Access, {path});
+}
+
+void CacheJournal::update(const Entry &entry)
+{
+    append(Update, entry);
+}
+
+void CacheJournal::evict(const QString &path)
+{
+    append(Evict, {path});
+}
+
+void CacheJournal::flush()
+{
+    QByteArray buffer;
+    int count = 0;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        buffer.swap(buffer_);
+        count = buffered_;
+        buffered_ = 0;
+        flushing_ = false;
+    }
+    if (count == 0)
+        return;
+    std::lock_guard<std::mutex> l(fileLock_);
+    if (!journal_.isOpen()) {
+        bool empty = !journal_.exists() || journal_.size() == 0;
+        if (!journal_.open(QFile::WriteOnly | QFile::Append)) {
+            qWarning() << "CacheJournal open failed" << journal_.fileName() << journal_.errorString();
+            return;
+        }
+        if (empty) {
+            QDataStream ds(&journal_);
+            ds << MAGIC_JOURNAL << VERSION;
+        }
+    }
+    journal_.write(buffer);
+    journal_.flush();
+    records_ += count;
+    if (records_ > qMax(1024, entries_ * 2))
+        compact();
+}
+
+void CacheJournal::append(quint8 op, const Entry &entry)
+{
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> l(lock_);
+        QDataStream ds(&buffer_, QIODevice::WriteOnly | QIODevice::Append);
+        ds << op;
+        if (op == Put || op == Update)
+            ds << entry;
+        else
+            ds << entry.path;
+        ++buffered_;
+        // hits wait for a batch, others are flushed soon
+        if (!flushing_ && (op != Access || buffered_ >= BATCH)) {
+            flushing_ = true;
+            schedule = true;
+        }
+    }
+    if (schedule)
+        thread().postWork([this] () { flush(); });
+}
+
+// in file lock
+bool CacheJournal::replay(QList<Entry> &entries, int &records, bool &torn)
+{
+    QFile snapshot(prefix_ + ".snapshot");
+    if (!snapshot.open(QFile::ReadOnly))
+        return false;
+    struct Item
+    {
+        Entry entry;
+        quint64 order;
+    };
+    QHash<QString, Item> items;
+    quint64 order = 0;
+    {
+        QDataStream ds(&snapshot);
+        quint32 magic = 0, version = 0, count = 0;
+        ds >> magic >> version >> count;
+        if (magic != MAGIC_SNAPSHOT || version != VERSION)
+            return false;
+        items.reserve(static_cast<int>(count));
+        for (quint32 i = 0; i < count; ++i) {
+            Entry e;
+            ds >> e;
+            if (ds.status() != QDataStream::Ok)
+                return false;
+            items.insert(e.path, {e, order++});
+        }
+    }
+    records = 0;
+    torn = false;
+    QFile journal(journal_.fileName());
+    if (journal.open(QFile::ReadOnly)) {
+        QDataStream ds(&journal);
+        quint32 magic = 0, version = 0;
+        ds >> magic >> version;
+        while (magic == MAGIC_JOURNAL && version == VERSION && !ds.atEnd()) {
+            quint8 op = 0;
+            Entry e;
+            ds >> op;
+            if (op == Put || op == Update)
+                ds >> e;
+            else
+                ds >> e.path;
+            // torn tail of crash, ignore
+            if (ds.status() != QDataStream::Ok) {
+                torn = true;
+                break;
+            }
+            ++records;
+            auto iter = items.find(e.path);
+            switch (op) {
+            case Put:
+                items.insert(e.path, {e, order++});
+                break;
+            case Access:
+                if (iter != items.end())
+                    iter->order = order++;
+                break;
+            case Update:
+                if (iter != items.end())
+                    iter->entry = e;
+                break;
+            case Evict:
+                if (iter != items.end())
+                    items.erase(iter);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    QVector<Item> list;
+    list.reserve(items.size());
+    for (Item & i : items)
+        list.append(i);
+    std::sort(list.begin(), list.end(), [] (Item const & l, Item const & r) {
+        return l.order < r.order;
+    });
+    entries.clear();
+    entries.reserve(list.size());
+    for (Item & i : list)
+        entries.append(i.entry);
+    return true;
+}
+
+// in file lock
+void CacheJournal::writeSnapshot(const QList<Entry> &entries)
+{
+    QSaveFile file(prefix_ + ".snapshot");
+    if (!file.open(QFile::WriteOnly)) {
+        qWarning() << "CacheJournal snapshot failed" << file.fileName() << file.errorString();
+        return;
+    }
+    QDataStream ds(&file);
+    ds << MAGIC_SNAPSHOT << VERSION << static_cast<quint32>(entries.size());
+    for (Entry const & e : entries)
+        ds << e;
+    if (!file.commit())
+        qWarning() << "CacheJournal snapshot failed" << file.fileName() << file.errorString();
+}
+
+// in file lock
+void CacheJournal::compact()
+{
+    journal_.close();
+    QList<Entry> entries;
+    int records = 0;
+    bool torn = false;
+    if (!replay(entries, records, torn))
+        return;
+    // snapshot first, replay of old journal on new snapshot gives same result
+    writeSnapshot(entries);
+    QFile::remove(journal_.fileName());
+    entries_ = entries.size();
+    records_ = 0;
+}
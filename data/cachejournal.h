@@ -0,0 +1,87 @@
+#ifndef CACHEJOURNAL_H
+#define CACHEJOURNAL_H
+
+#include "ShowBoard_global.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QFile>
+
+#include <mutex>
+#include <functional>
+
+/*
+ * Persistent index of FileCache, restores LRU order, sizes and hashes at
+ *  startup in one sequential read, instead of scanning cache directory;
+ *  also a hash manifest, hash is trusted while file stat (size, mtime,
+ *  inode) is not changed
+ *
+ *  <prefix>.snapshot: entries in LRU order (oldest first)
+ *  <prefix>.journal: put/access/update/evict records after snapshot
+ *
+ * Records are buffered in memory and appended in batches on a worker, hits
+ *  only cost a buffer append; journal is compacted into a new snapshot
+ *  when it grows larger than twice the entries
+ */
+
+class SHOWBOARD_EXPORT CacheJournal
+{
+public:
+    struct Entry
+    {
+        QString path;
+        qint64 size = -1;
+        QByteArray hash;
+        qint64 mtime = 0; // seconds
+        quint64 inode = 0;
+    };
+
+    // prefix is file path without suffix, beside cache directory
+    CacheJournal(QString const & prefix);
+
+    ~CacheJournal();
+
+public:
+    // entries in LRU order, oldest first; false if there is no valid snapshot
+    bool restore(QList<Entry> & entries);
+
+    // replace with entries (oldest first), after a directory scan; entries
+    //  is called in file lock, records appended after it are kept
+    void reset(std::function<QList<Entry> ()> entries);
+
+public:
+    void put(Entry const & entry);
+
+    void access(QString const & path);
+
+    // change size, hash or stat, not order
+    void update(Entry const & entry);
+
+    void evict(QString const & path);
+
+    // write buffered records now
+    void flush();
+
+private:
+    void append(quint8 op, Entry const & entry);
+
+    bool replay(QList<Entry> & entries, int & records, bool & torn);
+
+    void writeSnapshot(QList<Entry> const & entries);
+
+    void compact();
+
+private:
+    QString prefix_;
+    std::mutex lock_; // buffer
+    QByteArray buffer_;
+    int buffered_ = 0;
+    bool flushing_ = false;
+    std::mutex fileLock_; // files
+    QFile journal_;
+    int records_ = 0;
+    int entries_ = 0;
+};
+
+#endif // CACHEJOURNAL_H
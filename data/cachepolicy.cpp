@@ -0,0 +1,322 @@
+#include "cachepolicy.h"
+
+#include <QSet>
+#include <QQueue>
+
+/* CachePolicy */
+
+CachePolicy::~CachePolicy()
+{
+}
+
+void CachePolicy::keep(CacheNode *node)
+{
+    pushBack(node->segment, node);
+}
+
+void CachePolicy::remove(CacheNode *node, bool evicted)
+{
+    (void) evicted;
+    unlink(node);
+}
+
+void CachePolicy::resize(CacheNode *node, quint64 size)
+{
+    List & l = lists_[node->segment];
+    l.size = l.size - node->size + size;
+    node->size = size;
+}
+
+void CachePolicy::clear()
+{
+    for (List & l : lists_)
+        l = List();
+}
+
+void CachePolicy::pushFront(int segment, CacheNode *node)
+{
+    List & l = lists_[segment];
+    node->segment = segment;
+    node->prev = nullptr;
+    node->next = l.head;
+    if (l.head)
+        l.head->prev = node;
+    else
+        l.tail = node;
+    l.head = node;
+    l.size += node->size;
+    ++l.count;
+}
+
+void CachePolicy::pushBack(int segment, CacheNode *node)
+{
+    List & l = lists_[segment];
+    node->segment = segment;
+    node->next = nullptr;
+    node->prev = l.tail;
+    if (l.tail)
+        l.tail->next = node;
+    else
+        l.head = node;
+    l.tail = node;
+    l.size += node->size;
+    ++l.count;
+}
+
+void CachePolicy::unlink(CacheNode *node)
+{
+    List & l = lists_[node->segment];
+    if (node->prev)
+        node->prev->next = node->next;
+    else
+        l.head = node->next;
+    if (node->next)
+        node->next->prev = node->prev;
+    else
+        l.tail = node->prev;
+    node->prev = node->next = nullptr;
+    l.size -= node->size;
+    --l.count;
+}
+
+void CachePolicy::moveTo(int segment, CacheNode *node)
+{
+    if (node->segment == segment && lists_[segment].head == node)
+        return;
+    unlink(node);
+    pushFront(segment, node);
+}
+
+int CachePolicy::count() const
+{
+    int count = 0;
+    for (List const & l : lists_)
+        count += l.count;
+    return count;
+}
+
+quint64 CachePolicy::size() const
+{
+    quint64 size = 0;
+    for (List const & l : lists_)
+        size += l.size;
+    return size;
+}
+
+/* LruPolicy */
+
+class LruPolicy : public CachePolicy
+{
+public:
+    virtual Type type() const override { return Lru; }
+
+    virtual void insert(CacheNode * node) override
+    {
+        pushFront(0, node);
+    }
+
+    virtual void access(CacheNode * node) override
+    {
+        moveTo(0, node);
+    }
+
+    virtual CacheNode * victim() override
+    {
+        return lists_[0].tail;
+    }
+};
+
+/* TwoQueuePolicy */
+
+class TwoQueuePolicy : public CachePolicy
+{
+    enum { In, Main };
+
+public:
+    virtual Type type() const override { return TwoQueue; }
+
+    virtual void insert(CacheNode * node) override
+    {
+        pushFront(ghosts_.remove(node->hash) ? Main : In, node);
+    }
+
+    virtual void access(CacheNode * node) override
+    {
+        // In is FIFO, hit there is not a sign of reuse
+        if (node->segment == Main)
+            moveTo(Main, node);
+    }
+
+    virtual void remove(CacheNode * node, bool evicted) override
+    {
+        if (evicted && node->segment == In) {
+            ghosts_.insert(node->hash);
+            ghostOrder_.enqueue(node->hash);
+            int limit = qMax(256, count());
+            while (ghostOrder_.size() > limit)
+                ghosts_.remove(ghostOrder_.dequeue());
+        }
+        CachePolicy::remove(node, evicted);
+    }
+
+    virtual CacheNode * victim() override
+    {
+        List const & in = lists_[In];
+        if ((in.size > capacity_ / 4 && in.count > 1) || lists_[Main].count == 0)
+            return in.tail;
+        return lists_[Main].tail;
+    }
+
+    virtual void clear() override
+    {
+        CachePolicy::clear();
+        ghosts_.clear();
+        ghostOrder_.clear();
+    }
+
+private:
+    QSet<uint> ghosts_;
+    QQueue<uint> ghostOrder_;
+};
+
+/* WTinyLfuPolicy */
+
+class WTinyLfuPolicy : public CachePolicy
+{
+    enum { Window, Probation, Protected, Candidate };
+
+public:
+    virtual Type type() const override { return WTinyLfu; }
+
+    virtual void insert(CacheNode * node) override
+    {
+        // frequency is counted at miss before
+        pushFront(Window, node);
+        sketch_.ensureCapacity(count());
+        // never the newest one, it is at head of window
+        quint64 windowCapacity = qMax<quint64>(capacity_ / 100, 1);
+        while (lists_[Window].size > windowCapacity && lists_[Window].count > 1)
+            moveTo(Candidate, lists_[Window].tail);
+        // admit for free while there is room
+        while (lists_[Candidate].count > 0 && size() <= capacity_)
+            moveTo(Probation, lists_[Candidate].tail);
+    }
+
+    virtual void access(CacheNode * node) override
+    {
+        sketch_.increment(node->hash);
+        if (node->segment == Probation) {
+            moveTo(Protected, node);
+            List const & prot = lists_[Protected];
+            if (prot.size > capacity_ * 4 / 5 && prot.count > 1)
+                moveTo(Probation, prot.tail);
+        } else if (node->segment == Candidate) {
+            moveTo(Window, node);
+        } else {
+            moveTo(node->segment, node);
+        }
+    }
+
+    virtual void miss(uint hash) override
+    {
+        sketch_.increment(hash);
+    }
+
+    virtual CacheNode * victim() override
+    {
+        CacheNode * candidate = lists_[Candidate].tail;
+        CacheNode * victim = lists_[Probation].tail;
+        if (victim == nullptr)
+            victim = lists_[Protected].tail;
+        if (candidate && victim) {
+            if (sketch_.frequency(candidate->hash) > sketch_.frequency(victim->hash)) {
+                moveTo(Probation, candidate);
+                return victim;
+            }
+            return candidate;
+        }
+        if (candidate)
+            return candidate;
+        if (victim)
+            return victim;
+        return lists_[Window].tail;
+    }
+
+    virtual void clear() override
+    {
+        CachePolicy::clear();
+        sketch_.clear();
+    }
+
+private:
+    FrequencySketch sketch_;
+};
+
+CachePolicy *CachePolicy::create(CachePolicy::Type type)
+{
+    switch (type) {
+    case TwoQueue:
+        return new TwoQueuePolicy;
+    case WTinyLfu:
+        return new WTinyLfuPolicy;
+    default:
+        return new LruPolicy;
+    }
+}
+
+/* FrequencySketch */
+
+static constexpr uint SEEDS[] = {0x97cb3127u, 0xb492b66fu, 0x9ae16a3bu, 0xc2b2ae35u};
+
+FrequencySketch::FrequencySketch(int width)
+    : width_(width)
+    , table_(ROWS * width, 0)
+{
+}
+
+void FrequencySketch::ensureCapacity(int entries)
+{
+    if (entries <= width_)
+        return;
+    int width = width_;
+    while (width < entries)
+        width *= 2;
+    width_ = width;
+    table_.fill(0, ROWS * width_);
+    additions_ = 0;
+}
+
+void FrequencySketch::increment(uint hash)
+{
+    for (int r = 0; r < ROWS; ++r) {
+        quint8 & c = table_[r * width_ + index(hash, r)];
+        if (c < 15)
+            ++c;
+    }
+    if (++additions_ >= width_ * 10) {
+        for (quint8 & c : table_)
+            c >>= 1;
+        additions_ /= 2;
+    }
+}
+
+int FrequencySketch::frequency(uint hash) const
+{
+    int f = 15;
+    for (int r = 0; r < ROWS; ++r)
+        f = qMin<int>(f, table_[r * width_ + index(hash, r)]);
+    return f;
+}
+
+void FrequencySketch::clear()
+{
+    table_.fill(0);
+    additions_ = 0;
+}
+
+int FrequencySketch::index(uint hash, int row) const
+{
+    // width is power of 2
+    uint h = (hash ^ (hash >> 16)) * SEEDS[row];
+    return static_cast<int>((h ^ (h >> 15)) & static_cast<uint>(width_ - 1));
+}
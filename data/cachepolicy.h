@@ -0,0 +1,150 @@
+#ifndef CACHEPOLICY_H
+#define CACHEPOLICY_H
+
+#include "ShowBoard_global.h"
+
+#include <QVector>
+
+/*
+ * Eviction and admission policy of LRUCache, orders entries (nodes) of cache
+ *  in its own segments and chooses victims, cache keeps index and sizes
+ *
+ *  Lru: one LRU list, same as before policies
+ *  TwoQueue: new entries in FIFO (1/4 of capacity), entries seen again
+ *   after evicted from FIFO (ghost keys) go to main LRU
+ *  WTinyLfu: new entries in small LRU window (1/100), out of window they
+ *   are admitted to main SLRU (probation, protected 4/5) if there is room,
+ *   otherwise duel with victim of main by frequency estimated with
+ *   count-min sketch, loser is evicted
+ */
+
+struct CacheNode
+{
+    CacheNode * prev = nullptr;
+    CacheNode * next = nullptr;
+    quint64 size = 0;
+    uint hash = 0;
+    int segment = 0;
+};
+
+struct CacheStats
+{
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+
+    qreal hitRatio() const
+    {
+        quint64 total = hits + misses;
+        return total ? static_cast<qreal>(hits) / total : 0;
+    }
+
+    CacheStats & operator+=(CacheStats const & o)
+    {
+        hits += o.hits;
+        misses += o.misses;
+        evictions += o.evictions;
+        return *this;
+    }
+};
+
+class SHOWBOARD_EXPORT CachePolicy
+{
+public:
+    enum Type
+    {
+        Lru,
+        TwoQueue,
+        WTinyLfu,
+    };
+
+    static CachePolicy * create(Type type);
+
+    virtual ~CachePolicy();
+
+public:
+    virtual Type type() const = 0;
+
+    virtual void setCapacity(quint64 capacity) { capacity_ = capacity; }
+
+    // new entry, size and hash are set
+    virtual void insert(CacheNode * node) = 0;
+
+    // hit
+    virtual void access(CacheNode * node) = 0;
+
+    // miss of key
+    virtual void miss(uint hash) { (void) hash; }
+
+    // victim refused to be destroyed and removed for this eviction round,
+    //  put back at eviction end of its segment, keeps no recency for it
+    virtual void keep(CacheNode * node);
+
+    virtual void remove(CacheNode * node, bool evicted);
+
+    virtual void resize(CacheNode * node, quint64 size);
+
+    // next entry to evict, null if empty
+    virtual CacheNode * victim() = 0;
+
+    virtual void clear();
+
+protected:
+    // intrusive list, head is most recent
+    struct List
+    {
+        CacheNode * head = nullptr;
+        CacheNode * tail = nullptr;
+        quint64 size = 0;
+        int count = 0;
+    };
+
+    void pushFront(int segment, CacheNode * node);
+
+    void pushBack(int segment, CacheNode * node);
+
+    void unlink(CacheNode * node);
+
+    void moveTo(int segment, CacheNode * node);
+
+    int count() const;
+
+    quint64 size() const;
+
+protected:
+    quint64 capacity_ = 0;
+    List lists_[4];
+};
+
+/*
+ * Count-min sketch of 4 rows of saturating 4 bit counters (in bytes), all
+ *  counters are halved after 10 * width increments, so that old popularity
+ *  fades out
+ */
+
+class SHOWBOARD_EXPORT FrequencySketch
+{
+public:
+    FrequencySketch(int width = 1024);
+
+public:
+    // grow (and reset) to fit number of entries
+    void ensureCapacity(int entries);
+
+    void increment(uint hash);
+
+    int frequency(uint hash) const;
+
+    void clear();
+
+private:
+    int index(uint hash, int row) const;
+
+private:
+    static constexpr int ROWS = 4;
+    int width_;
+    int additions_ = 0;
+    QVector<quint8> table_;
+};
+
+#endif // CACHEPOLICY_H
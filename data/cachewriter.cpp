@@ -0,0 +1,150 @@
+#include "cachewriter.h"
+#include "core/workthread.h"
+
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace QtPromise;
+
+static WorkThread& thread()
+{
+    static WorkThread th("CacheWriter");
+    return th;
+}
+
+QSharedPointer<CacheWriter> CacheWriter::create(const QString &fileName)
+{
+    return QSharedPointer<CacheWriter>(new CacheWriter(fileName), &QObject::deleteLater);
+}
+
+CacheWriter::CacheWriter(const QString &fileName)
+    : file_(fileName)
+{
+}
+
+CacheWriter::~CacheWriter()
+{
+}
+
+qint64 CacheWriter::open()
+{
+    if (!file_.open(QFile::ReadWrite))
+        return -1;
+    qint64 size = file_.size();
+    file_.seek(size);
+    return size;
+}
+
+void CacheWriter::reset()
+{
+    file_.resize(0);
+    file_.seek(0);
+}
+
+void CacheWriter::preallocate(qint64 size)
+{
+    QSharedPointer<CacheWriter> self = sharedFromThis();
+    thread().postWork([self, size] () {
+#ifdef Q_OS_LINUX
+        // reserve blocks only, keep file size
+        if (::fallocate(self->file_.handle(), FALLOC_FL_KEEP_SIZE, 0, size) == 0)
+            self->preallocated_ = true;
+#else
+        (void) self;
+        (void) size;
+#endif
+    });
+}
+
+qint64 CacheWriter::room() const
+{
+    qint64 room = static_cast<qint64>(MAX_CHUNKS - queued_) * CHUNK_SIZE - pending_.size();
+    return qMax<qint64>(room, 0);
+}
+
+void CacheWriter::write(const QByteArray &data)
+{
+    pending_.append(data);
+    int n = 0;
+    for (; pending_.size() - n >= CHUNK_SIZE; n += CHUNK_SIZE)
+        post(pending_.mid(n, CHUNK_SIZE));
+    if (n > 0)
+        pending_.remove(0, n);
+}
+
+QtPromise::QPromise<void> CacheWriter::finish(SyncPolicy sync)
+{
+    QByteArray rest;
+    rest.swap(pending_);
+    QSharedPointer<CacheWriter> self = sharedFromThis();
+    // after all queued chunks
+    return thread().asyncWork([self, rest, sync] () {
+        self->close(rest, sync);
+    });
+}
+
+QtPromise::QPromise<void> CacheWriter::abort()
+{
+    aborted_ = true;
+    pending_.clear();
+    QSharedPointer<CacheWriter> self = sharedFromThis();
+    return thread().asyncWork([self] () {
+        self->file_.close();
+    });
+}
+
+void CacheWriter::post(const QByteArray &chunk)
+{
+    ++queued_;
+    QSharedPointer<CacheWriter> self = sharedFromThis();
+    thread().postWork([self, chunk] () {
+        self->writeChunk(chunk);
+    });
+}
+
+// on writer thread
+void CacheWriter::writeChunk(const QByteArray &chunk)
+{
+    if (!aborted_ && !failed_ && file_.write(chunk) != chunk.size()) {
+        qWarning() << "CacheWriter write failed" << file_.fileName() << file_.errorString();
+        failed_ = true;
+    }
+    if (queued_-- == MAX_CHUNKS)
+        emit drained();
+}
+
+// on writer thread
+void CacheWriter::close(const QByteArray &rest, SyncPolicy sync)
+{
+    if (!failed_ && !rest.isEmpty() && file_.write(rest) != rest.size())
+        failed_ = true;
+    if (!failed_ && !file_.flush())
+        failed_ = true;
+#ifdef Q_OS_LINUX
+    // release reserved blocks beyond data, if total size was wrong
+    if (!failed_ && preallocated_ && ::ftruncate(file_.handle(), file_.pos()) != 0)
+        qWarning() << "CacheWriter truncate failed" << file_.fileName();
+#endif
+    if (!failed_ && sync == SyncOnFinish && !this->sync())
+        failed_ = true;
+    if (failed_)
+        qWarning() << "CacheWriter finish failed" << file_.fileName() << file_.errorString();
+    file_.close();
+    if (failed_)
+        throw std::runtime_error("文件写入失败");
+}
+
+bool CacheWriter::sync()
+{
+#ifdef Q_OS_WIN
+    return ::_commit(file_.handle()) == 0;
+#else
+    return ::fsync(file_.handle()) == 0;
+#endif
+}
@@ -0,0 +1,94 @@
+#ifndef CACHEWRITER_H
+#define CACHEWRITER_H
+
+#include "ShowBoard_global.h"
+
+#include <QtPromise>
+
+#include <QObject>
+#include <QFile>
+#include <QEnableSharedFromThis>
+
+#include <atomic>
+
+/*
+ * Write behind sink of FileCache downloads
+ *  reader (on thread of stream) cuts data into fixed size chunks, a writer
+ *  thread writes them in order; queue is bounded, reader reads only as much
+ *  as room() and waits for drained() when it is full, network reply buffer
+ *  is limited too, so that TCP flow control slows down sender instead of
+ *  memory growing
+ *
+ * Whole file is preallocated when total size is known, file size is not
+ *  changed by that, so size of unfinished file is still resume offset
+ */
+
+class SHOWBOARD_EXPORT CacheWriter : public QObject, public QEnableSharedFromThis<CacheWriter>
+{
+    Q_OBJECT
+public:
+    enum SyncPolicy
+    {
+        NoSync,
+        SyncOnFinish, // fsync before file is put in place
+    };
+
+    static constexpr int CHUNK_SIZE = 256 * 1024;
+    static constexpr int MAX_CHUNKS = 8;
+
+    // deleted on own thread, even if released on writer thread
+    static QSharedPointer<CacheWriter> create(QString const & fileName);
+
+    virtual ~CacheWriter() override;
+
+public:
+    QString fileName() const { return file_.fileName(); }
+
+    // keep existing data to resume, return its size, -1 if failed
+    qint64 open();
+
+    // drop existing data, when stream can't resume
+    void reset();
+
+    // reserve disk space of whole file
+    void preallocate(qint64 size);
+
+public:
+    // bytes that can be written now, 0 when queue is full
+    qint64 room() const;
+
+    void write(QByteArray const & data);
+
+    bool failed() const { return failed_; }
+
+    // write rest, sync by policy and close
+    QtPromise::QPromise<void> finish(SyncPolicy sync);
+
+    // drop queued chunks and close
+    QtPromise::QPromise<void> abort();
+
+signals:
+    // on writer thread, queue is not full any more
+    void drained();
+
+private:
+    CacheWriter(QString const & fileName);
+
+    void post(QByteArray const & chunk);
+
+    void writeChunk(QByteArray const & chunk);
+
+    void close(QByteArray const & rest, SyncPolicy sync);
+
+    bool sync();
+
+private:
+    QFile file_;
+    QByteArray pending_; // reader side, less than a chunk
+    std::atomic<int> queued_{0};
+    std::atomic<bool> failed_{false};
+    std::atomic<bool> aborted_{false};
+    bool preallocated_ = false;
+};
+
+#endif // CACHEWRITER_H
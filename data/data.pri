@@ -1,4 +1,7 @@
 SOURCES += \
+    $$PWD/cachejournal.cpp \
+    $$PWD/cachepolicy.cpp \
+    $$PWD/cachewriter.cpp \
     $$PWD/dataprovider.cpp \
     $$PWD/dataurlcodec.cpp \
     $$PWD/filecache.cpp \
@@ -6,13 +9,15 @@ SOURCES += \
     $$PWD/httpstream.cpp \
     $$PWD/imagecache.cpp \
     $$PWD/localhttpserver.cpp \
-    $$PWD/lrucache.cpp \
     $$PWD/resourcecache.cpp \
     $$PWD/svgcache.cpp \
     $$PWD/urlfilecache.cpp \
     $$PWD/zipfilecache.cpp
 
 HEADERS += \
+    $$PWD/cachejournal.h \
+    $$PWD/cachepolicy.h \
+    $$PWD/cachewriter.h \
     $$PWD/dataprovider.h \
     $$PWD/dataurlcodec.h \
     $$PWD/filecache.h \
@@ -8,6 +8,16 @@
 #include <QBuffer>
 #include <QNetworkReply>
 #include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QDebug>
+
+#include <limits>
+#include <chrono>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
 
 using namespace QtPromise;
 
@@ -17,6 +27,33 @@ static WorkThread& thread()
     return th;
 }
 
+static WorkThread& removeThread()
+{
+    static WorkThread th("FileCacheRemove");
+    return th;
+}
+
+static WorkThread& scrubThread()
+{
+    static WorkThread th("FileCacheScrub");
+    th.setPriority(QThread::IdlePriority);
+    return th;
+}
+
+// sub directories are created by puts and removed by remove thread
+static std::mutex& dirLock()
+{
+    static std::mutex m;
+    return m;
+}
+
+// wait for queued work, not if quitted at exit
+static void drain(WorkThread & th)
+{
+    if (th.isRunning())
+        th.sendWork([] () {});
+}
+
 FileCache::FileCache(const QDir &dir, quint64 capacity, QByteArray algorithm)
     : base(capacity)
     , dir_(dir)
@@ -25,6 +62,18 @@ FileCache::FileCache(const QDir &dir, quint64 capacity, QByteArray algorithm)
     dir.mkpath(dir.path());
 }
 
+FileCache::~FileCache()
+{
+    // queued work holds this, loader posts to scrub and remove threads
+    scrubRate_ = 0;
+    ++scrubGeneration_;
+    wakeScrub();
+    drain(thread());
+    drain(scrubThread());
+    drain(removeThread());
+    journal_.reset();
+}
+
 QtPromise::QPromise<QString> FileCache::putUrl(QObject * context, const QString &path, const QByteArray &hash, const QUrl &url)
 {
     return putStream(context, path, hash, [url](QObject * context) {
@@ -38,18 +87,25 @@ QtPromise::QPromise<QString> FileCache::putUrl(QObject * context, const QString
 
 QPromise<QString> FileCache::putStream(QString const & path, QByteArray const & hash, QSharedPointer<QIODevice> stream)
 {
+    // cached file with hash is missed before index is loaded
+    if (!indexed_ && !hash.isEmpty() && journal_) {
+        return ready_.then([this, path, hash, stream] () {
+            return putStream(path, hash, stream);
+        });
+    }
     QString fullPath = dir_.filePath(path);
     FileResource f = get(path, hash);
     if (f.size >= 0) { // not replace old
         return QPromise<QString>::resolve(fullPath);
     }
+    claim(path);
     std::lock_guard<std::mutex> l(FileCache::lock());
     auto iter = asyncPuts_.find(path);
     if (iter != asyncPuts_.end())
         return iter.value();
-    QPromise<QString> asyncPut = saveStream(fullPath, stream, putsStatus_[path])
+    QPromise<QString> asyncPut = saveStream(fullPath, stream, putsStatus_[path], syncPolicy_)
             .then([this, path, fullPath, hash] (qint64 size) {
-        base::put(path, FileResource {size, hash});
+        putIndex(path, FileResource {size, hash});
         return fullPath;
     }).finally([this, path] () {
         std::lock_guard<std::mutex> l(FileCache::lock());
@@ -62,18 +118,24 @@ QPromise<QString> FileCache::putStream(QString const & path, QByteArray const &
 
 QtPromise::QPromise<QString> FileCache::putStream(QObject *context, QString const & path, QByteArray const & hash, std::function<QtPromise::QPromise<QSharedPointer<QIODevice>> (QObject *)> openStream)
 {
+    if (!indexed_ && !hash.isEmpty() && journal_) {
+        return ready_.then([this, context, path, hash, openStream] () {
+            return putStream(context, path, hash, openStream);
+        });
+    }
     QString fullPath = dir_.filePath(path);
     FileResource f = get(path, hash);
     if (f.size >= 0) {
         return QPromise<QString>::resolve(fullPath);
     }
+    claim(path);
     std::lock_guard<std::mutex> l(FileCache::lock());
     auto iter = asyncPuts_.find(path);
     if (iter != asyncPuts_.end())
         return iter.value();
     QPromise<QString> asyncPut = openStream(context).then([this, path, fullPath, hash] (QSharedPointer<QIODevice> stream) {
-        return saveStream(fullPath, stream, putsStatus_[path]).then([this, path, fullPath, hash] (qint64 size) {
-            base::put(path, FileResource {size, hash});
+        return saveStream(fullPath, stream, putsStatus_[path], syncPolicy_).then([this, path, fullPath, hash] (qint64 size) {
+            putIndex(path, FileResource {size, hash});
             return fullPath;
         });
     }).finally([this, path] () {
@@ -92,6 +154,7 @@ QString FileCache::putData(QString const & path, QByteArray const & hash, QByteA
     if (f.size >= 0 && (hash.isEmpty() || f.hash == hash)) {
         return fullPath;
     }
+    claim(path);
     QFile file(fullPath + ".temp2");
     bool ok = file.open(QFile::WriteOnly);
     ok = ok && file.write(data) == data.size();
@@ -101,16 +164,18 @@ QString FileCache::putData(QString const & path, QByteArray const & hash, QByteA
         file.remove();
         return nullptr;
     }
-    base::put(path, FileResource {data.size(), hash});
+    putIndex(path, FileResource {data.size(), hash});
     return fullPath;
 }
 
 FileCache::PutStatus FileCache::getPutStatus(const QString &path)
 {
-    std::lock_guard<std::mutex> l(FileCache::lock());
-    auto iter = putsStatus_.find(path);
-    if (iter != putsStatus_.end())
-        return iter.value();
+    {
+        std::lock_guard<std::mutex> l(FileCache::lock());
+        auto iter = putsStatus_.find(path);
+        if (iter != putsStatus_.end())
+            return iter.value();
+    }
     FileResource f = get(path);
     if (f.size >= 0) {
         return {f.size, f.size};
@@ -142,6 +207,32 @@ QByteArray FileCache::getData(QString const & path)
     return data;
 }
 
+QSharedPointer<FileMapping> FileCache::mapData(const QString &path)
+{
+    FileResource f = get(path);
+    if (f.size <= 0)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> l(FileCache::lock());
+        // evicted after get, file is going away
+        if (tombstones_.contains(path))
+            return nullptr;
+        ++mappings_[path];
+    }
+    QSharedPointer<FileMapping> mapping(new FileMapping(this, path, dir_.filePath(path)));
+    if (!mapping->isMapped())
+        return nullptr;
+    return mapping;
+}
+
+void FileCache::unmap(const QString &path)
+{
+    std::lock_guard<std::mutex> l(FileCache::lock());
+    auto iter = mappings_.find(path);
+    if (iter != mappings_.end() && --iter.value() == 0)
+        mappings_.erase(iter);
+}
+
 QString FileCache::getFile(QString const & path)
 {
     FileResource f = get(path);
@@ -171,23 +262,34 @@ bool FileCache::contains(QString const & path)
 FileResource FileCache::get(QString const & path, QByteArray const & hash, bool touch)
 {
     FileResource f = base::get(path);
-    if (f.size < 0) {
+    if (f.size < 0 && !indexed_) {
+        // index not loaded yet, don't wait, look at file directly;
+        //  not put in index, load will do that
+        if (hash.isEmpty()) {
+            CacheJournal::Entry e = statEntry(path);
+            f.size = e.size;
+            return f;
+        }
+        // hash is only known by index, miss until it is loaded, async puts
+        //  wait for ready() instead
         return f;
     }
+    if (f.size < 0)
+        return f;
     if (!hash.isEmpty() && hash != f.hash) {
-        LRUCache::remove(path);
+        base::remove(path);
         f.size = -1;
         return f;
     }
     QString fullPath = dir_.filePath(path);
     if (!QFile::exists(fullPath)) {
-        LRUCache::remove(path);
+        base::remove(path);
         f.size = -1;
         return f;
     }
-    if (touch)
-        QFile(fullPath).setFileTime(
-                QDateTime::currentDateTime(), QFile::FileModificationTime);
+    // order in index is already updated, persist it in journal
+    if (touch && journal_)
+        journal_->access(path);
     return f;
 }
 
@@ -199,20 +301,118 @@ quint64 FileCache::sizeOf(const FileResource &v)
 bool FileCache::destroy(const QString &k, const FileResource &v)
 {
     (void) v;
-    if (!QFile::remove(dir_.filePath(k)))
-        return false;
-    int n = 0;
-    QString p = k;
-    while ((n = p.lastIndexOf('/')) > 0) {
-        p = p.left(n);
-        if (!dir_.rmdir(p)) {
-            break;
-        }
+    {
+        std::lock_guard<std::mutex> l(FileCache::lock());
+        // in use, evicted later when unmapped
+        if (mappings_.contains(k))
+            return false;
+        removeLater(k);
     }
+    if (journal_)
+        journal_->evict(k);
     return true;
 }
 
+// in lock
+void FileCache::removeLater(const QString &path)
+{
+    if (tombstones_.contains(path))
+        return;
+    tombstones_.insert(path, false);
+    removes_.append(path);
+    if (removes_.size() == 1)
+        removeThread().postWork([this] () { removeFiles(); });
+}
+
 void FileCache::load(std::function<bool (QString const & name)> filter)
+{
+    journal_.reset(new CacheJournal(dir_.absolutePath()));
+    QDateTime since = QDateTime::currentDateTime();
+    ready_ = thread().asyncWork([this, filter, since] () {
+        loadIndex(filter, since);
+    });
+}
+
+void FileCache::loadIndex(std::function<bool (QString const & name)> filter, QDateTime const & since)
+{
+    QList<CacheJournal::Entry> entries;
+    if (journal_->restore(entries)) {
+        auto end = std::remove_if(entries.begin(), entries.end(), [&filter] (CacheJournal::Entry const & e) {
+            return !filter(e.path.mid(e.path.lastIndexOf('/') + 1));
+        });
+        entries.erase(end, entries.end());
+        // not replace puts made while loading
+        for (CacheJournal::Entry const & e : entries) {
+            if (!base::contains(e.path))
+                base::put(e.path, FileResource{e.size, e.hash});
+        }
+        // files of lost records and temp files, never scanned again
+        scrubThread().postWork([this, since] () { reconcile(since); });
+    } else {
+        entries = scan(filter);
+        for (CacheJournal::Entry const & e : entries) {
+            if (!base::contains(e.path))
+                base::put(e.path, FileResource{e.size, nullptr});
+        }
+        // puts made while loading are in index, but maybe not scanned
+        journal_->reset([this, &entries] () {
+            QList<CacheJournal::Entry> all;
+            QSet<QString> scanned;
+            for (CacheJournal::Entry e : entries) {
+                scanned.insert(e.path);
+                FileResource f = base::peek(e.path);
+                if (f.size < 0) // evicted, record follows
+                    continue;
+                if (!f.hash.isEmpty()) {
+                    CacheJournal::Entry st = statEntry(e.path);
+                    e.mtime = st.mtime;
+                    e.inode = st.inode;
+                    e.hash = f.hash;
+                }
+                all.append(e);
+            }
+            for (QString const & path : base::keys()) {
+                if (scanned.contains(path))
+                    continue;
+                FileResource f = base::peek(path);
+                if (f.size < 0)
+                    continue;
+                CacheJournal::Entry e = statEntry(path);
+                e.size = f.size;
+                if (!f.hash.isEmpty()) {
+                    CacheJournal::Entry st = statEntry(e.path);
+                    e.mtime = st.mtime;
+                    e.inode = st.inode;
+                    e.hash = f.hash;
+                }
+                all.append(e);
+            }
+            return all;
+        });
+    }
+    indexed_ = true;
+    if (algorithm_.isEmpty()) {
+        loaded();
+        return;
+    }
+    // trust hash of manifest if file is not changed, otherwise hash again
+    thread().asyncWork([this, entries] () {
+        for (CacheJournal::Entry const & e : entries) {
+            CacheJournal::Entry s = statEntry(e.path);
+            if (s.size < 0) // gone, dropped on get
+                continue;
+            if (!e.hash.isEmpty() && s.size == e.size && s.mtime == e.mtime && s.inode == e.inode)
+                continue;
+            s.hash = hashFile(dir_.filePath(e.path));
+            if (s.hash.isEmpty())
+                continue;
+            base::update(e.path, FileResource{s.size, s.hash});
+            journal_->update(s);
+        }
+    }).then([this] () { loaded(); });
+}
+
+QList<CacheJournal::Entry> FileCache::scan(std::function<bool (QString const & name)> filter)
 {
     QFileInfoList files;
     QList<QDir> dirs = {dir_};
@@ -235,27 +435,40 @@ void FileCache::load(std::function<bool (QString const & name)> filter)
     std::sort(files.begin(), files.end(), [] (QFileInfo const & l, QFileInfo const & r) {
         return l.lastModified() < r.lastModified();
     });
-    for (QFileInfo & f : files) {
-        base::put(f.filePath().mid(n), FileResource{f.size(), nullptr});
-    }
-    if (algorithm_.isEmpty()) {
-        loaded();
-    } else {
-        QCryptographicHash::Algorithm al = QVariant(algorithm_).value<QCryptographicHash::Algorithm>();
-        for (QFileInfo & f : files) {
-            thread().asyncWork([al, f] () -> FileResource {
-                QFile file(f.filePath());
-                if (!file.open(QFile::ReadOnly)) {
-                    throw std::runtime_error(file.errorString().toUtf8());
-                }
-                QCryptographicHash hash(al);
-                hash.addData(&file);
-                return FileResource{f.size(), hash.result()};
-            }).then([this, p = f.filePath().mid(n)] (FileResource const & f) {
-                base::update(p, f);
-            });
+    QList<CacheJournal::Entry> entries;
+    for (QFileInfo & f : files)
+        entries.append({f.filePath().mid(n), f.size(), nullptr});
+    return entries;
+}
+
+void FileCache::reconcile(const QDateTime &since)
+{
+    QList<QDir> dirs = {dir_};
+    int n = dir_.path().length() + 1;
+    while (!dirs.isEmpty()) {
+        QDir dir = dirs.takeFirst();
+        for (QFileInfo const & f : dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (f.isDir()) {
+                dirs.append(f.filePath());
+                continue;
+            }
+            // files of this run are not in index yet, puts are in progress;
+            //  temp files are resumed by later puts
+            QString path = f.filePath().mid(n);
+            if (f.lastModified() >= since || path.endsWith(".temp")
+                    || base::contains(path))
+                continue;
+            {
+                // put may start now, check and mark removal at once
+                std::lock_guard<std::mutex> l(FileCache::lock());
+                if (asyncPuts_.contains(path))
+                    continue;
+                removeLater(path);
+            }
+            qWarning() << "FileCache remove orphan" << path;
+            if (journal_)
+                journal_->evict(path);
         }
-        thread().asyncWork([] () {}).then([this] () { loaded(); });
     }
 }
 
@@ -264,66 +477,335 @@ void FileCache::check(const QString &path, const QByteArray &hash)
     get(path, hash, false);
 }
 
-QtPromise::QPromise<qint64> FileCache::saveStream(const QString &path, QSharedPointer<QIODevice> stream, PutStatus & status)
+void FileCache::putIndex(const QString &path, const FileResource &f)
+{
+    // old entry stays when its removal was refused (mapped), put keeps it
+    if (base::contains(path))
+        base::update(path, f);
+    else
+        base::put(path, f);
+    if (journal_ == nullptr)
+        return;
+    CacheJournal::Entry e{path, f.size, f.hash};
+    // stat only matters with hash
+    if (!f.hash.isEmpty()) {
+        CacheJournal::Entry s = statEntry(path);
+        e.mtime = s.mtime;
+        e.inode = s.inode;
+    }
+    journal_->put(e);
+}
+
+CacheJournal::Entry FileCache::statEntry(const QString &path) const
+{
+    CacheJournal::Entry e{path};
+    QString fullPath = dir_.filePath(path);
+#ifdef Q_OS_WIN
+    QFileInfo info(fullPath);
+    if (info.exists()) {
+        e.size = info.size();
+        e.mtime = info.lastModified().toSecsSinceEpoch();
+    }
+#else
+    struct stat st;
+    if (::stat(QFile::encodeName(fullPath).constData(), &st) == 0) {
+        e.size = st.st_size;
+        e.mtime = st.st_mtime;
+        e.inode = st.st_ino;
+    }
+#endif
+    return e;
+}
+
+QByteArray FileCache::hashFile(const QString &fullPath) const
+{
+    QFile file(fullPath);
+    if (!file.open(QFile::ReadOnly))
+        return nullptr;
+    QCryptographicHash::Algorithm al = QVariant(algorithm_).value<QCryptographicHash::Algorithm>();
+    QCryptographicHash hash(al);
+    hash.addData(&file);
+    return hash.result();
+}
+
+void FileCache::setScrubRate(qint64 bytesPerSecond)
+{
+    qint64 old = scrubRate_.exchange(bytesPerSecond);
+    wakeScrub();
+    if (old <= 0 && bytesPerSecond > 0 && !algorithm_.isEmpty()) {
+        // old pass may not have seen the stop yet, let it exit
+        int generation = ++scrubGeneration_;
+        scrubThread().postWork([this, generation] () { scrub(generation); });
+    }
+}
+
+void FileCache::wakeScrub()
+{
+    // in lock, so that waiting scrub sees new rate, or gets notified
+    std::lock_guard<std::mutex> l(FileCache::lock());
+    scrubCond_.notify_all();
+}
+
+void FileCache::setCorruptionHandler(std::function<void (const QString &)> handler)
+{
+    std::lock_guard<std::mutex> l(FileCache::lock());
+    corruptionHandler_ = handler;
+}
+
+void FileCache::scrub(int generation)
+{
+    constexpr qint64 CHUNK = 64 * 1024;
+    QCryptographicHash::Algorithm al = QVariant(algorithm_).value<QCryptographicHash::Algorithm>();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    for (QString const & path : base::keys()) {
+        FileResource f = base::peek(path);
+        if (f.size < 0 || f.hash.isEmpty())
+            continue;
+        QFile file(dir_.filePath(path));
+        if (!file.open(QFile::ReadOnly))
+            continue;
+        QCryptographicHash hash(al);
+        qint64 read = 0;
+        while (true) {
+            qint64 rate = scrubRate_;
+            if (rate <= 0 || scrubGeneration_ != generation)
+                return;
+            QByteArray data = file.read(CHUNK);
+            if (data.isEmpty())
+                break;
+            hash.addData(data);
+            read += data.size();
+            bytes += data.size();
+            // throttle to rate over whole pass, wake up on rate change or stop
+            qint64 wait = bytes * 1000 / rate - timer.elapsed();
+            if (wait > 0) {
+                std::unique_lock<std::mutex> l(FileCache::lock());
+                scrubCond_.wait_for(l, std::chrono::milliseconds(wait), [this, rate, generation] () {
+                    return scrubRate_ != rate || scrubGeneration_ != generation;
+                });
+            }
+        }
+        file.close();
+        // replaced or evicted while reading, not corrupted
+        FileResource f2 = base::peek(path);
+        if (f2.size != f.size || f2.hash != f.hash)
+            continue;
+        if (read == f.size && hash.result() == f.hash)
+            continue;
+        qWarning() << "FileCache corrupted" << path;
+        base::remove(path);
+        std::function<void (QString const &)> handler;
+        {
+            std::lock_guard<std::mutex> l(FileCache::lock());
+            handler = corruptionHandler_;
+        }
+        if (handler)
+            handler(path);
+    }
+    // next pass
+    if (scrubRate_ > 0 && scrubGeneration_ == generation)
+        scrubThread().postWork([this, generation] () { scrub(generation); });
+}
+
+void FileCache::claim(const QString &path)
+{
+    std::unique_lock<std::mutex> l(FileCache::lock());
+    auto iter = tombstones_.find(path);
+    if (iter == tombstones_.end())
+        return;
+    if (iter.value()) {
+        // removing on remove thread, wait for it
+        removed_.wait(l, [this, &path] () { return !tombstones_.contains(path); });
+        return;
+    }
+    // take over removal, old file must go before new one is put in place
+    tombstones_.erase(iter);
+    l.unlock();
+    removeFile(path);
+}
+
+void FileCache::removeFiles()
+{
+    std::unique_lock<std::mutex> l(FileCache::lock());
+    while (!removes_.isEmpty()) {
+        QString path = removes_.takeFirst();
+        auto iter = tombstones_.find(path);
+        if (iter == tombstones_.end()) // claimed by put
+            continue;
+        iter.value() = true;
+        l.unlock();
+        removeFile(path);
+        l.lock();
+        tombstones_.remove(path);
+        removed_.notify_all();
+    }
+}
+
+void FileCache::removeFile(const QString &path)
 {
-    QDir().mkdir(path.left(path.lastIndexOf('/')));
-    QSharedPointer<QFile> file(new QFile(path + ".temp"));
-    if (!file->open(QFile::ReadWrite)) {
+    QString fullPath = dir_.filePath(path);
+    if (!QFile::remove(fullPath) && QFile::exists(fullPath)) {
+        // left to be found by next load
+        qWarning() << "FileCache remove failed" << fullPath;
+        return;
+    }
+    std::lock_guard<std::mutex> l(dirLock());
+    int n = 0;
+    QString p = path;
+    while ((n = p.lastIndexOf('/')) > 0) {
+        p = p.left(n);
+        if (!dir_.rmdir(p)) {
+            break;
+        }
+    }
+}
+
+QtPromise::QPromise<qint64> FileCache::saveStream(const QString &path, QSharedPointer<QIODevice> stream, PutStatus & status,
+                                                  CacheWriter::SyncPolicy sync)
+{
+    QSharedPointer<CacheWriter> writer = CacheWriter::create(path + ".temp");
+    qint64 size = -1;
+    {
+        std::lock_guard<std::mutex> l(dirLock());
+        QDir().mkdir(path.left(path.lastIndexOf('/')));
+        size = writer->open();
+    }
+    if (size < 0) {
         return QPromise<qint64>::reject(std::runtime_error("文件打开失败"));
     }
-    return QPromise<qint64>([file, stream, &status](
+    if (size > 0) {
+        if (stream->seek(size))
+            status.progress = size;
+        else
+            writer->reset();
+    }
+    // network buffers no more than writer queue, rest is left to TCP
+    HttpStream::setReadBufferSize(stream.get(), CacheWriter::CHUNK_SIZE * CacheWriter::MAX_CHUNKS);
+    return QPromise<qint64>([writer, stream, &status, sync](
                              const QPromiseResolve<qint64>& resolve,
                              const QPromiseReject<qint64>& reject) {
-        auto error = [file, reject](std::exception && e) {
-            file->close();
-            reject(e);
+        struct State
+        {
+            bool ended = false;
+            bool settled = false;
         };
-        auto finished = [file, &status, resolve] () {
-            if (status.progress >= 0) {
-                file->close();
-                resolve(status.progress);
-            }
-        };
-        auto read = [file, &status, stream, error] () {
-            QByteArray data = stream->readAll();
-            if (data.isEmpty()) {
-                error(std::runtime_error("文件下载失败"));
+        QSharedPointer<State> state(new State);
+        auto error = [writer, state, reject](std::exception && e) {
+            if (state->settled)
                 return;
+            state->settled = true;
+            std::exception e2(e);
+            writer->abort().then([reject, e2] () {
+                reject(e2);
+            });
+        };
+        auto finish = [writer, state, &status, sync, resolve, reject] () {
+            state->settled = true;
+            qint64 size = status.progress;
+            writer->finish(sync).then([resolve, size] () {
+                resolve(size);
+            }).fail([reject] () {
+                reject(std::runtime_error("文件写入失败"));
+            });
+        };
+        // read only what queue takes, rest waits in network buffer; finish
+        //  when stream is ended and all read
+        auto pump = [writer, stream, state, &status, error, finish] () -> qint64 {
+            if (state->settled)
+                return 0;
+            qint64 read = 0;
+            qint64 room = 0;
+            while ((room = writer->room()) > 0) {
+                QByteArray data = stream->read(room);
+                if (data.isEmpty())
+                    break;
+                if (status.total == -2) {
+                    status.total = HttpStream::totalBytes(stream.get());
+                    if (status.total < 0)
+                        status.total = -1;
+                    else // remaining of resumed
+                        writer->preallocate(status.progress + status.total);
+                }
+                writer->write(data);
+                status.progress += data.size();
+                read += data.size();
             }
-            if (file->write(data) != data.size()) {
+            if (writer->failed())
                 error(std::runtime_error("文件写入失败"));
-                return;
-            }
-            if (status.total == -2) {
-                status.total = HttpStream::totalBytes(stream.get());
-                if (status.total < 0)
-                    status.total = -1;
-            }
-            status.progress += data.size();
+            else if (state->ended && room > 0)
+                finish();
+            return read;
         };
-        qint64 size = file->size();
-        if (size > 0 && stream->seek(size)) {
-            file->seek(size);
-            status.progress = size;
-        }
-        char c;
-        if (stream->peek(&c, 1) > 0)
-            read();
-        if (HttpStream::connect(stream.get(), finished, error)) {
+        auto read = [writer, pump, error] () {
+            if (pump() == 0 && writer->room() > 0)
+                error(std::runtime_error("文件下载失败"));
+        };
+        auto ended = [state, pump] () {
+            state->ended = true;
+            pump();
+        };
+        QObject::connect(writer.get(), &CacheWriter::drained, stream.get(), [pump] () {
+            pump();
+        });
+        pump();
+        if (HttpStream::connect(stream.get(), ended, error)) {
             return;
         }
         QObject::connect(stream.get(), &QIODevice::readyRead, read);
-        QObject::connect(stream.get(), &QIODevice::readChannelFinished, finished);
-    }).then([path, file] (qint64 size) {
-        if (!QFile::rename(file->fileName(), path)) {
-            file->remove();
+        QObject::connect(stream.get(), &QIODevice::readChannelFinished, ended);
+    }).then([path, writer] (qint64 size) {
+        if (!QFile::rename(writer->fileName(), path)) {
+            QFile::remove(writer->fileName());
             throw std::runtime_error("文件写入失败");
         }
         return size;
-    }, [path, file] (std::exception &) -> qint64 {
-        file->remove();
+    }, [writer] (std::exception &) -> qint64 {
+        QFile::remove(writer->fileName());
         throw;
-    }).finally([stream]() {
+    }).finally([stream, writer]() {
         stream->disconnect();
+        writer->disconnect();
     });
 }
+
+FileMapping::FileMapping(const QByteArray &data)
+    : size_(data.size())
+    , data_(data)
+{
+}
+
+FileMapping::FileMapping(FileCache *cache, const QString &path, const QString &fullPath)
+    : cache_(cache)
+    , path_(path)
+    , file_(fullPath)
+{
+    if (!file_.open(QFile::ReadOnly))
+        return;
+    qint64 size = file_.size();
+    // QByteArray is limited to int
+    if (size > 0 && size <= std::numeric_limits<int>::max())
+        map_ = file_.map(0, size);
+    if (map_)
+        size_ = size;
+    else
+        file_.close();
+}
+
+FileMapping::~FileMapping()
+{
+    if (map_) {
+        file_.unmap(map_);
+        file_.close();
+    }
+    if (cache_)
+        cache_->unmap(path_);
+}
+
+QByteArray FileMapping::data() const
+{
+    if (map_)
+        return QByteArray::fromRawData(reinterpret_cast<char const *>(map_), static_cast<int>(size_));
+    return data_;
+}
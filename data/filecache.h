@@ -3,20 +3,74 @@
 
 #include "ShowBoard_global.h"
 #include "lrucache.h"
+#include "cachejournal.h"
+#include "cachewriter.h"
 
 #include <QFile>
 #include <QDir>
+#include <QDateTime>
 #include <QtPromise>
 
+#include <condition_variable>
+
 struct FileResource
 {
     qint64 size = -1;
     QByteArray hash; // md5
 };
 
-class SHOWBOARD_EXPORT FileCache : public LRUCache<QString, FileResource, std::mutex>
+class FileCache;
+
+/*
+ * Read only data of cached file, memory mapped, no copy; cache does not evict
+ *  the file while it is mapped
+ * Also holds data that can't be mapped (not cached, in zip, empty), so that
+ *  readers need only one code path
+ */
+
+class SHOWBOARD_EXPORT FileMapping
 {
-    typedef LRUCache<QString, FileResource, std::mutex> base;
+public:
+    FileMapping(QByteArray const & data);
+
+    ~FileMapping();
+
+public:
+    // raw data over mapping, valid while this mapping lives, copy if kept longer
+    QByteArray data() const;
+
+    qint64 size() const { return size_; }
+
+    bool isMapped() const { return map_ != nullptr; }
+
+private:
+    friend class FileCache;
+
+    FileMapping(FileCache * cache, QString const & path, QString const & fullPath);
+
+    Q_DISABLE_COPY(FileMapping)
+
+private:
+    FileCache * cache_ = nullptr;
+    QString path_;
+    QFile file_;
+    uchar * map_ = nullptr;
+    qint64 size_ = 0;
+    QByteArray data_;
+};
+
+/*
+ * Files cached in dir, index is sharded so that lookups from GUI, worker and
+ *  LocalHttpServer threads do not contend on one lock
+ *
+ * Evicted entries leave index at once, their files are removed on a worker;
+ *  a tombstone marks the path until then, a put of the same path claims it;
+ *  mapped files are not evicted until unmapped
+ */
+
+class SHOWBOARD_EXPORT FileCache : public ShardedLRUCache<QString, FileResource>
+{
+    typedef ShardedLRUCache<QString, FileResource> base;
 
 public:
     class PutStatus {
@@ -27,6 +81,8 @@ public:
 
     FileCache(QDir const & dir, quint64 capacity, QByteArray algorithm = nullptr);
 
+    virtual ~FileCache() override;
+
 public:
     QtPromise::QPromise<QString> putUrl(QObject * context, QString const & path, QByteArray const & hash, QUrl const & url);
 
@@ -42,6 +98,9 @@ public:
 
     virtual QByteArray getData(QString const & path);
 
+    // null if not cached or can't be mapped
+    QSharedPointer<FileMapping> mapData(QString const & path);
+
     virtual QString getFile(QString const & path);
 
     virtual QtPromise::QPromise<QString> getFileAsync(QString const & path);
@@ -52,26 +111,95 @@ public:
 
     PutStatus getPutStatus(QString const & path);
 
+public:
+    // index is loaded, before that lookups check files directly, lookups
+    //  with hash miss, async puts with hash wait for index
+    QtPromise::QPromise<void> ready() const { return ready_; }
+
+    bool isReady() const { return indexed_; }
+
+public:
+    // verify hashes of cached files in background, at most bytes per second,
+    //  0 to stop; only with hash algorithm
+    void setScrubRate(qint64 bytesPerSecond);
+
+    // called on scrub thread, entry is already removed
+    void setCorruptionHandler(std::function<void (QString const & path)> handler);
+
+    // for downloads, default NoSync
+    void setSyncPolicy(CacheWriter::SyncPolicy sync) { syncPolicy_ = sync; }
+
 protected:
     virtual quint64 sizeOf(const FileResource &v) override;
 
+    // queue file removal, no io in index lock
     virtual bool destroy(const QString &k, const FileResource &v) override;
 
     virtual void loaded() {}
 
 protected:
+    // restore index on worker, from journal or by scanning dir if there is
+    //  no journal; loaded() is called on worker after hashes are verified
     void load(std::function<bool (QString const & name)> filter);
 
     void check(QString const & path, QByteArray const & hash);
 
+    // for own state, not index; don't access index in it
+    std::mutex & lock() { return lock_; }
+
 private:
-    static QtPromise::QPromise<qint64> saveStream(QString const & path, QSharedPointer<QIODevice> stream, PutStatus & status);
+    friend class FileMapping;
+
+    void unmap(QString const & path);
+
+    void loadIndex(std::function<bool (QString const & name)> filter, QDateTime const & since);
+
+    QList<CacheJournal::Entry> scan(std::function<bool (QString const & name)> filter);
+
+    // destroy files older than since that are not in index
+    void reconcile(QDateTime const & since);
+
+    void putIndex(QString const & path, FileResource const & f);
+
+    CacheJournal::Entry statEntry(QString const & path) const;
+
+    QByteArray hashFile(QString const & fullPath) const;
+
+    void scrub(int generation);
+
+    void wakeScrub();
+
+    void claim(QString const & path);
+
+    void removeLater(QString const & path);
+
+    void removeFiles();
+
+    void removeFile(QString const & path);
+
+    static QtPromise::QPromise<qint64> saveStream(QString const & path, QSharedPointer<QIODevice> stream, PutStatus & status,
+                                                  CacheWriter::SyncPolicy sync);
 
 protected:
     QDir dir_;
     QByteArray algorithm_;
+    std::mutex lock_;
     QMap<QString, PutStatus> putsStatus_;
     QMap<QString, QtPromise::QPromise<QString>> asyncPuts_;
+
+private:
+    QScopedPointer<CacheJournal> journal_;
+    QtPromise::QPromise<void> ready_ = QtPromise::QPromise<void>::resolve();
+    std::atomic<bool> indexed_{false};
+    QMap<QString, bool> tombstones_; // path -> removing now
+    QMap<QString, int> mappings_; // path -> alive mappings
+    QStringList removes_;
+    std::condition_variable removed_;
+    std::atomic<qint64> scrubRate_{0};
+    std::atomic<int> scrubGeneration_{0};
+    std::condition_variable scrubCond_;
+    std::function<void (QString const & path)> corruptionHandler_;
+    std::atomic<CacheWriter::SyncPolicy> syncPolicy_{CacheWriter::NoSync};
 };
 
 #endif // FILECACHE_H
@@ -12,6 +12,7 @@ HttpStream::HttpStream(QObject * context, QNetworkReply *reply)
     , lastPos_(0)
     , speed_(0)
     , elapsed_(0)
+    , readBufferSize_(0)
 {
     open(ReadOnly);
     if (context) {
@@ -89,6 +90,16 @@ qint64 HttpStream::totalBytes(QIODevice *stream)
     }
 }
 
+void HttpStream::setReadBufferSize(QIODevice *stream, qint64 size)
+{
+    if (auto reply = qobject_cast<QNetworkReply*>(stream)) {
+        reply->setReadBufferSize(size);
+    } else if (HttpStream * http = qobject_cast<HttpStream*>(stream)) {
+        http->readBufferSize_ = size;
+        http->reply_->setReadBufferSize(size);
+    }
+}
+
 qint64 HttpStream::size() const
 {
     return reply_->header(QNetworkRequest::ContentLengthHeader).toLongLong();
@@ -159,6 +170,7 @@ void HttpStream::onFinished()
 
 void HttpStream::reopen()
 {
+    reply_->setReadBufferSize(readBufferSize_);
     QObject::connect(reply_, &QNetworkReply::finished, this, &HttpStream::onFinished);
     QObject::connect(reply_, &QNetworkReply::readyRead, this, &HttpStream::onReadyRead);
 #if QT_VERSION >= 0x51500
@@ -20,6 +20,9 @@ public:
 
     static qint64 totalBytes(QIODevice * stream);
 
+    // limit data buffered in reply, also for retry replies, 0 for no limit
+    static void setReadBufferSize(QIODevice * stream, qint64 size);
+
 public:
     qint64 size() const override;
 
@@ -57,6 +60,7 @@ private:
     qint64 lastPos_;
     qint64 speed_;
     int elapsed_; // in seconds
+    qint64 readBufferSize_;
 };
 
 
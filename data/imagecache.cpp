@@ -1,4 +1,5 @@
 #include "imagecache.h"
+#include "filecache.h"
 #include "core/oomhandler.h"
 #include "core/resource.h"
 #include "core/workthread.h"
@@ -49,10 +50,10 @@ QtPromise::QPromise<QSharedPointer<ImageData>> ImageCache::getOrCreate(QObject *
     }
     QPointer<QObject> ctx(context);
     QtPromise::QPromise<QSharedPointer<ImageData>> p =
-            Resource::getData(context, url).then([this, url, mipmap](QByteArray data) {
-        if (data.size() < 100 * 1024) {
+            Resource::mapData(context, url).then([this, url, mipmap](QSharedPointer<FileMapping> data) {
+        if (data->size() < 100 * 1024) {
             QPixmap pixmap;
-            if (pixmap.loadFromData(data))
+            if (pixmap.loadFromData(data->data()))
                 return QtPromise::resolve(put(url, pixmap, mipmap));
             else
                 throw std::runtime_error("图片加载失败");
@@ -83,12 +84,13 @@ QSharedPointer<ImageData> ImageCache::put(const QUrl &url, const QPixmap &pixmap
     return data;
 }
 
-QtPromise::QPromise<QPixmap> ImageCache::load(QByteArray data)
+QtPromise::QPromise<QPixmap> ImageCache::load(QSharedPointer<FileMapping> data)
 {
+    // mapping is kept until decoded
     return ::thread().asyncWork([data]() {
         OomHandler::ensureMemoryAvailable(50 * 1024 * 1024);
         QPixmap pixmap;
-        if (pixmap.loadFromData(data))
+        if (pixmap.loadFromData(data->data()))
             return pixmap;
         else
             throw std::runtime_error("图片加载失败");
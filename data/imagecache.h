@@ -10,6 +10,8 @@
 #include <QPixmap>
 #include <QUrl>
 
+class FileMapping;
+
 class SHOWBOARD_EXPORT ImageData : public QEnableSharedFromThis<ImageData>
 {
 public:
@@ -57,7 +59,7 @@ signals:
     void onLoadError(QObject * context, QUrl const & url);
 
 private:
-    static QtPromise::QPromise<QPixmap> load(QByteArray data);
+    static QtPromise::QPromise<QPixmap> load(QSharedPointer<FileMapping> data);
 
     bool dropOneImage();
 
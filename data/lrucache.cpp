@@ -1 +0,0 @@
-#include "lrucache.h"
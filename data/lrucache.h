@@ -1,88 +1,125 @@
 #ifndef LRUCACHE_H
 #define LRUCACHE_H
 
-#include <QLinkedList>
-#include <QMap>
+#include "ShowBoard_global.h"
+#include "cachepolicy.h"
+
+#include <QHash>
+#include <QList>
+#include <QVarLengthArray>
 
 #include <mutex>
+#include <atomic>
 
 class EmptyMutex
 {
 public:
-    void lock();
-    void unlock();
+    void lock() {}
+    void unlock() {}
 };
 
+/*
+ * LRU cache, entries are intrusive nodes indexed by hash table, ordered by
+ *  eviction policy (LRU by default, see CachePolicy); get/put/remove are
+ *  O(1), a hit only splices pointers, no allocation
+ *
+ * Subclass gives size of value, and may refuse to destroy an entry (in use),
+ *  which then stays in cache and is skipped by eviction
+ */
+
 template <typename K, typename V, typename L = EmptyMutex>
 class LRUCache
 {
+    struct Node : CacheNode
+    {
+        K key;
+        V value;
+    };
+
 public:
-    LRUCache(quint64 capacity)
+    LRUCache(quint64 capacity, CachePolicy::Type policy = CachePolicy::Lru)
         : capacity_(capacity)
         , size_(0)
+        , policy_(CachePolicy::create(policy))
     {
+        policy_->setCapacity(capacity);
     }
 
-    virtual ~LRUCache() {}
+    virtual ~LRUCache()
+    {
+        for (Node * n : index_)
+            delete n;
+        delete policy_;
+    }
+
+    Q_DISABLE_COPY(LRUCache)
 
 public:
     void put(K const & k, V const & v)
     {
         std::lock_guard<L> lock(lock_);
-        if (lruMap_.contains(k)) {
+        if (index_.contains(k)) {
             return;
         }
-        lruList_.prepend(QPair<K, V>(k, v));
-        lruMap_.insert(k, lruList_.begin());
-        size_ += sizeOf(v);
-        QList<QPair<K, V>> rejects;
-        while (size_ > capacity_) {
-            QPair<K, V> & l = lruList_.back();
-            if (destroy(l.first, l.second)) {
-                size_ -= sizeOf(l.second);
-                lruMap_.remove(l.first);
-                lruList_.removeLast();
-                // recheck rejects
-                for (auto & r : rejects)
-                    lruList_.append(r);
-                rejects.clear();
+        Node * n = new Node;
+        n->key = k;
+        n->value = v;
+        n->size = sizeOf(v);
+        n->hash = qHash(k);
+        index_.insert(k, n);
+        policy_->insert(n);
+        size_ += n->size;
+        // entries that refuse to destroy are kept, try each at most once
+        int tries = index_.size();
+        QVarLengthArray<Node *, 8> kept;
+        while (tries-- > 0 && overflow(size_)) {
+            Node * l = static_cast<Node *>(policy_->victim());
+            if (l == nullptr)
+                break;
+            if (destroy(l->key, l->value)) {
+                size_ -= l->size;
+                index_.remove(l->key);
+                policy_->remove(l, true);
+                delete l;
+                ++stats_.evictions;
             } else {
-                rejects.prepend(lruList_.takeLast());
+                policy_->remove(l, false);
+                kept.append(l);
             }
         }
+        // back as next victims in same order, not as recently used
+        for (int i = kept.size() - 1; i >= 0; --i)
+            policy_->keep(kept[i]);
     }
 
     V get(K const & k)
     {
         std::lock_guard<L> lock(lock_);
-        auto iter = lruMap_.find(k);
-        if (iter == lruMap_.end()) {
+        auto iter = index_.find(k);
+        if (iter == index_.end()) {
+            ++stats_.misses;
+            policy_->miss(qHash(k));
             return V();
         }
-        typename QLinkedList<QPair<K, V>>::iterator & i = iter.value();
-        if (i != lruList_.begin()) {
-            lruList_.prepend(*i);
-            lruList_.erase(i);
-            i = lruList_.begin();
-        }
-        return i->second;
+        ++stats_.hits;
+        Node * n = iter.value();
+        policy_->access(n);
+        return n->value;
     }
 
     bool remove(K const & k)
     {
         std::lock_guard<L> lock(lock_);
-        auto iter = lruMap_.find(k);
-        if (iter == lruMap_.end()) {
+        auto iter = index_.find(k);
+        if (iter == index_.end()) {
             return false;
         }
-        typename QLinkedList<QPair<K, V>>::iterator i = iter.value();
-        lruMap_.erase(iter);
-        QPair<K, V> & l = *i;
-        if (destroy(l.first, l.second)) {
-            size_ -= sizeOf(l.second);
-            lruList_.erase(i);
-        } else {
-            lruMap_.insert(k, i);
+        Node * n = iter.value();
+        if (destroy(n->key, n->value)) {
+            size_ -= n->size;
+            index_.erase(iter);
+            policy_->remove(n, false);
+            delete n;
         }
         return true;
     }
@@ -90,16 +127,71 @@ public:
     bool contains(K const & k)
     {
         std::lock_guard<L> lock(lock_);
-        return lruMap_.contains(k);
+        return index_.contains(k);
+    }
+
+    // not change order or stats
+    V peek(K const & k)
+    {
+        std::lock_guard<L> lock(lock_);
+        auto iter = index_.find(k);
+        return iter == index_.end() ? V() : iter.value()->value;
+    }
+
+    QList<K> keys()
+    {
+        std::lock_guard<L> lock(lock_);
+        QList<K> keys;
+        keys.reserve(index_.size());
+        for (Node * n : index_)
+            keys.append(n->key);
+        return keys;
+    }
+
+    // may read without lock, then approximate
+    quint64 size() const { return size_; }
+
+    void setCapacity(quint64 capacity)
+    {
+        std::lock_guard<L> lock(lock_);
+        capacity_ = capacity;
+        policy_->setCapacity(capacity);
+    }
+
+    // entries are moved to new policy in order of old one
+    void setPolicy(CachePolicy::Type type)
+    {
+        std::lock_guard<L> lock(lock_);
+        CachePolicy * policy = CachePolicy::create(type);
+        policy->setCapacity(capacity_);
+        while (CacheNode * n = policy_->victim()) {
+            policy_->remove(n, false);
+            policy->insert(n);
+        }
+        delete policy_;
+        policy_ = policy;
+    }
+
+    CacheStats stats()
+    {
+        std::lock_guard<L> lock(lock_);
+        return stats_;
+    }
+
+    void resetStats()
+    {
+        std::lock_guard<L> lock(lock_);
+        stats_ = CacheStats();
     }
 
     void clear() {
         std::lock_guard<L> lock(lock_);
-        for (auto l : lruMap_) {
-            destroy(l->first, l->second);
+        for (Node * n : index_) {
+            destroy(n->key, n->value);
+            delete n;
         }
-        lruList_.clear();
-        lruMap_.clear();
+        index_.clear();
+        policy_->clear();
         size_ = 0;
     }
 
@@ -113,6 +205,11 @@ protected:
         return false;
     }
 
+    virtual bool overflow(quint64 size)
+    {
+        return size > capacity_;
+    }
+
 protected:
     L & lock() { return lock_; }
 
@@ -120,20 +217,181 @@ protected:
     void update(K const & k, V const & v)
     {
         std::lock_guard<L> lock(lock_);
-        auto iter = lruMap_.find(k);
-        if (iter == lruMap_.end()) {
+        auto iter = index_.find(k);
+        if (iter == index_.end()) {
             return;
         }
-        typename QLinkedList<QPair<K, V>>::iterator & i = iter.value();
-        i->second = v;
+        Node * n = iter.value();
+        quint64 size = sizeOf(v);
+        size_ += size - n->size;
+        policy_->resize(n, size);
+        n->value = v;
     }
 
 private:
-    quint64 size_;
     quint64 capacity_;
+    std::atomic<quint64> size_;
     L lock_;
-    QLinkedList<QPair<K, V>> lruList_;
-    QMap<K, typename QLinkedList<QPair<K, V>>::iterator> lruMap_;
+    CachePolicy * policy_;
+    CacheStats stats_;
+    QHash<K, Node *> index_;
+};
+
+/*
+ * LRU cache split into N shards by key hash, each shard has own lock and
+ *  1/N of capacity as its share; a shard may grow over its share while total
+ *  size (sum of shards, approximate as read without locks) is in capacity
+ */
+
+template <typename K, typename V, int N = 16>
+class ShardedLRUCache
+{
+    class Shard : public LRUCache<K, V, std::mutex>
+    {
+    public:
+        Shard() : LRUCache<K, V, std::mutex>(0) {}
+
+        using LRUCache<K, V, std::mutex>::update;
+
+        ShardedLRUCache * owner = nullptr;
+
+    protected:
+        virtual quint64 sizeOf(V const & v) override
+        {
+            return owner->sizeOf(v);
+        }
+
+        virtual bool destroy(K const & k, V const & v) override
+        {
+            return owner->destroy(k, v);
+        }
+
+        virtual bool overflow(quint64 size) override
+        {
+            return owner->overflow(size);
+        }
+    };
+
+public:
+    ShardedLRUCache(quint64 capacity, CachePolicy::Type policy = CachePolicy::Lru)
+        : capacity_(capacity)
+    {
+        for (Shard & s : shards_) {
+            s.owner = this;
+            s.setCapacity(capacity / N);
+            if (policy != CachePolicy::Lru)
+                s.setPolicy(policy);
+        }
+    }
+
+    virtual ~ShardedLRUCache() {}
+
+    Q_DISABLE_COPY(ShardedLRUCache)
+
+public:
+    void put(K const & k, V const & v)
+    {
+        shard(k).put(k, v);
+    }
+
+    V get(K const & k)
+    {
+        return shard(k).get(k);
+    }
+
+    bool remove(K const & k)
+    {
+        return shard(k).remove(k);
+    }
+
+    bool contains(K const & k)
+    {
+        return shard(k).contains(k);
+    }
+
+    V peek(K const & k)
+    {
+        return shard(k).peek(k);
+    }
+
+    QList<K> keys()
+    {
+        QList<K> keys;
+        for (Shard & s : shards_)
+            keys.append(s.keys());
+        return keys;
+    }
+
+    void clear()
+    {
+        for (Shard & s : shards_)
+            s.clear();
+    }
+
+    quint64 size() const
+    {
+        quint64 size = 0;
+        for (Shard const & s : shards_)
+            size += s.size();
+        return size;
+    }
+
+    quint64 capacity() const { return capacity_; }
+
+    void setPolicy(CachePolicy::Type type)
+    {
+        for (Shard & s : shards_)
+            s.setPolicy(type);
+    }
+
+    CacheStats stats()
+    {
+        CacheStats stats;
+        for (Shard & s : shards_)
+            stats += s.stats();
+        return stats;
+    }
+
+    void resetStats()
+    {
+        for (Shard & s : shards_)
+            s.resetStats();
+    }
+
+protected:
+    // called in lock of shard of k
+    virtual quint64 sizeOf(V const & v) = 0;
+
+    virtual bool destroy(K const & k, V const & v)
+    {
+        (void) k;
+        (void) v;
+        return false;
+    }
+
+protected:
+    // not change order
+    void update(K const & k, V const & v)
+    {
+        shard(k).update(k, v);
+    }
+
+private:
+    bool overflow(quint64 shardSize) const
+    {
+        if (shardSize > capacity_)
+            return true;
+        return shardSize > capacity_ / N && size() > capacity_;
+    }
+
+    Shard & shard(K const & k)
+    {
+        return shards_[qHash(k) % N];
+    }
+
+private:
+    quint64 capacity_;
+    Shard shards_[N];
 };
 
 #endif // LRUCACHE_H
@@ -43,6 +43,11 @@ QByteArray UrlFileCache::getData(const QUrl &url)
     return FileCache::getData(md5Path(url));
 }
 
+QSharedPointer<FileMapping> UrlFileCache::mapData(const QUrl &url)
+{
+    return FileCache::mapData(md5Path(url));
+}
+
 QString UrlFileCache::getFile(const QUrl &url)
 {
     return FileCache::getFile(md5Path(url));
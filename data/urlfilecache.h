@@ -31,6 +31,8 @@ public:
 
     QByteArray getData(QUrl const & url);
 
+    QSharedPointer<FileMapping> mapData(QUrl const & url);
+
     QString getFile(QUrl const & url);
 
     QtPromise::QPromise<QString> getFileAsync(QUrl const & url);
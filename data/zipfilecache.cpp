@@ -111,9 +111,12 @@ void ZipFileCache::unlock(const QStringList &files)
 
 bool ZipFileCache::destroy(const QString &k, const FileResource &v)
 {
-    // in lock
-    if (lockedFiles_.contains(k))
-        return false;
+    // in lock of index shard, take own lock after it
+    {
+        std::lock_guard<std::mutex> l(FileCache::lock());
+        if (lockedFiles_.contains(k))
+            return false;
+    }
     return FileCache::destroy(k, v);
 }
 
@@ -2,12 +2,14 @@
 !showboard_quick : {
 
     HEADERS += \
+        $$PWD/inkitem.h \
         $$PWD/itemframe.h \
         $$PWD/positionbar.h \
         $$PWD/selectbox.h \
         $$PWD/stateitem.h
 
     SOURCES += \
+        $$PWD/inkitem.cpp \
         $$PWD/itemframe.cpp \
         $$PWD/positionbar.cpp \
         $$PWD/selectbox.cpp \
@@ -0,0 +1,95 @@
+#include "inkitem.h"
+
+#include <QStyleOptionGraphicsItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+
+InkItem::InkItem(QGraphicsItem * parent)
+    : QGraphicsItem(parent)
+{
+    // need exposedRect, paint only tiles in it
+    setFlag(ItemUsesExtendedStyleOption);
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+void InkItem::setRect(const QRectF &rect)
+{
+    prepareGeometryChange();
+    rect_ = rect;
+}
+
+void InkItem::setPen(const QColor &color, qreal width)
+{
+    surface_.setPen(color, width);
+}
+
+void InkItem::startStroke(const QPointF &point, qreal width)
+{
+    updateRect(surface_.startStroke(point, width));
+}
+
+void InkItem::addPoint(const QPointF &point, qreal width)
+{
+    updateRect(surface_.addPoint(point, width));
+}
+
+void InkItem::addPoints(const QPolygonF &points)
+{
+    updateRect(surface_.addPoints(points));
+}
+
+void InkItem::addPoints(const QPolygonF &points, const QPolygonF &tail)
+{
+    QRectF dirty = surface_.addPoints(points);
+    updateRect(dirty | surface_.setTail(tail));
+}
+
+void InkItem::setTail(const QPolygonF &tail)
+{
+    updateRect(surface_.setTail(tail));
+}
+
+void InkItem::endStroke()
+{
+    updateRect(surface_.endStroke());
+}
+
+void InkItem::cancelStroke()
+{
+    updateRect(surface_.cancelStroke());
+}
+
+void InkItem::clear()
+{
+    updateRect(surface_.clear());
+}
+
+QRectF InkItem::boundingRect() const
+{
+    return rect_;
+}
+
+void InkItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    (void) widget;
+    // tiles follow device pixels, other parts are repainted at new scale
+    QRectF dirty = surface_.setScale(InkSurface::deviceScale(painter));
+    surface_.paint(painter, option->exposedRect);
+    latency_.painted();
+    if (!dirty.isEmpty())
+        update(dirty);
+}
+
+void InkItem::updateRect(const QRectF &rect)
+{
+    if (rect.isEmpty())
+        return;
+    update(rect);
+    if (immediate_ && scene()) {
+        QRectF srect = mapRectToScene(rect);
+        for (QGraphicsView * view : scene()->views()) {
+            QRect vrect = view->mapFromScene(srect).boundingRect().adjusted(-1, -1, 1, 1);
+            view->viewport()->repaint(vrect);
+        }
+    }
+}
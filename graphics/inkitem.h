@@ -0,0 +1,65 @@
+#ifndef INKITEM_H
+#define INKITEM_H
+
+#include "ShowBoard_global.h"
+#include "stroke/inksurface.h"
+#include "stroke/inkpredictor.h"
+
+#include <QGraphicsItem>
+
+/*
+ * Ink layer item, paints InkSurface and repaints only dirty rect of each edit
+ */
+
+class SHOWBOARD_EXPORT InkItem : public QGraphicsItem
+{
+public:
+    InkItem(QGraphicsItem * parent = nullptr);
+
+public:
+    void setRect(QRectF const & rect);
+
+    void setPen(QColor const & color, qreal width);
+
+    InkSurface & surface() { return surface_; }
+
+    // call on receiving input, sample is taken when painted
+    InkLatency & latency() { return latency_; }
+
+    // repaint views synchronously on each edit, not on next scene update
+    void setImmediate(bool immediate) { immediate_ = immediate; }
+
+public:
+    void startStroke(QPointF const & point, qreal width = 0);
+
+    void addPoint(QPointF const & point, qreal width = 0);
+
+    void addPoints(QPolygonF const & points);
+
+    // append points and replace tail in one update
+    void addPoints(QPolygonF const & points, QPolygonF const & tail);
+
+    void setTail(QPolygonF const & tail);
+
+    void endStroke();
+
+    void cancelStroke();
+
+    void clear();
+
+public:
+    virtual QRectF boundingRect() const override;
+
+    virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+
+private:
+    void updateRect(QRectF const & rect);
+
+private:
+    InkSurface surface_;
+    InkLatency latency_;
+    QRectF rect_;
+    bool immediate_ = false;
+};
+
+#endif // INKITEM_H
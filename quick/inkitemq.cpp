@@ -0,0 +1,89 @@
+#include "inkitemq.h"
+
+#include <QPainter>
+
+InkItem::InkItem(QQuickItem * parent)
+    : QQuickPaintedItem(parent)
+{
+    setRenderTarget(FramebufferObject);
+    setAntialiasing(true);
+    setAcceptedMouseButtons(Qt::NoButton);
+}
+
+void InkItem::setRect(const QRectF &rect)
+{
+    rect_ = rect;
+    setPosition(rect.topLeft());
+    setSize(rect.size());
+}
+
+void InkItem::setPen(const QColor &color, qreal width)
+{
+    surface_.setPen(color, width);
+}
+
+void InkItem::startStroke(const QPointF &point, qreal width)
+{
+    updateRect(surface_.startStroke(point, width));
+}
+
+void InkItem::addPoint(const QPointF &point, qreal width)
+{
+    updateRect(surface_.addPoint(point, width));
+}
+
+void InkItem::addPoints(const QPolygonF &points)
+{
+    updateRect(surface_.addPoints(points));
+}
+
+void InkItem::addPoints(const QPolygonF &points, const QPolygonF &tail)
+{
+    QRectF dirty = surface_.addPoints(points);
+    updateRect(dirty | surface_.setTail(tail));
+}
+
+void InkItem::setTail(const QPolygonF &tail)
+{
+    updateRect(surface_.setTail(tail));
+}
+
+void InkItem::endStroke()
+{
+    updateRect(surface_.endStroke());
+}
+
+void InkItem::cancelStroke()
+{
+    updateRect(surface_.cancelStroke());
+}
+
+void InkItem::clear()
+{
+    updateRect(surface_.clear());
+}
+
+QRectF InkItem::boundingRect() const
+{
+    return QRectF(QPointF(), rect_.size());
+}
+
+void InkItem::paint(QPainter *painter)
+{
+    // surface is in coordinates of rect, painter is clipped to dirty rect
+    QRectF exposed = painter->hasClipping() ? painter->clipBoundingRect() : boundingRect();
+    painter->translate(-rect_.topLeft());
+    // tiles follow device pixels, other parts are repainted at new scale
+    QRectF dirty = surface_.setScale(InkSurface::deviceScale(painter));
+    surface_.paint(painter, exposed.translated(rect_.topLeft()));
+    latency_.painted();
+    // on render thread
+    if (!dirty.isEmpty())
+        QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
+}
+
+void InkItem::updateRect(const QRectF &rect)
+{
+    if (!rect.isEmpty())
+        update(rect.translated(-rect_.topLeft()).toAlignedRect());
+}
@@ -0,0 +1,62 @@
+#ifndef INKITEM_H
+#define INKITEM_H
+
+#include "ShowBoard_global.h"
+#include "stroke/inksurface.h"
+#include "stroke/inkpredictor.h"
+
+#include <QQuickPaintedItem>
+
+/*
+ * Ink layer item, paints InkSurface and repaints only dirty rect of each edit
+ *  rendered into framebuffer object, so that content out of dirty rect is kept
+ */
+
+class SHOWBOARD_EXPORT InkItem : public QQuickPaintedItem
+{
+public:
+    InkItem(QQuickItem * parent = nullptr);
+
+public:
+    void setRect(QRectF const & rect);
+
+    void setPen(QColor const & color, qreal width);
+
+    InkSurface & surface() { return surface_; }
+
+    // call on receiving input, sample is taken when painted
+    InkLatency & latency() { return latency_; }
+
+public:
+    void startStroke(QPointF const & point, qreal width = 0);
+
+    void addPoint(QPointF const & point, qreal width = 0);
+
+    void addPoints(QPolygonF const & points);
+
+    // append points and replace tail in one update
+    void addPoints(QPolygonF const & points, QPolygonF const & tail);
+
+    void setTail(QPolygonF const & tail);
+
+    void endStroke();
+
+    void cancelStroke();
+
+    void clear();
+
+public:
+    virtual QRectF boundingRect() const override;
+
+    virtual void paint(QPainter *painter) override;
+
+private:
+    void updateRect(QRectF const & rect);
+
+private:
+    InkSurface surface_;
+    InkLatency latency_;
+    QRectF rect_;
+};
+
+#endif // INKITEM_H
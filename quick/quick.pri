@@ -11,12 +11,14 @@ SOURCES += \
 showboard_quick {
 
     HEADERS += \
+        $$PWD/inkitemq.h \
         $$PWD/itemframeq.h \
         $$PWD/positionbarq.h \
     $$PWD/selectboxq.h \
     $$PWD/stateitemq.h
 
     SOURCES += \
+        $$PWD/inkitemq.cpp \
         $$PWD/itemframeq.cpp \
         $$PWD/positionbarq.cpp \
     $$PWD/selectboxq.cpp \
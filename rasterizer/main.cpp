@@ -0,0 +1,143 @@
+/*
+ * strokesrasterizer: render stroke files to PNG without display
+ *
+ *  strokesrasterizer [options] files...
+ *    -o, --output <dir>   output directory (default: current)
+ *    -s, --size <WxH>     image size (default: 1920x1080)
+ *    -f, --fps <n>        write frame sequence at n fps, 0 for final image only
+ *    -j, --jobs <n>       parallel jobs (default: cpu cores)
+ *    -g, --max-gap <ms>   shorten pauses longer than ms in frame sequences
+ *    --format <type>      stroke format, default from file suffix
+ *
+ *  throughput (files/s, frames/s) is printed at end, use as benchmark
+ */
+
+#include "stroke/strokesreader.h"
+#include "stroke/imagestrokesrenderer.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+#include <atomic>
+
+struct Options
+{
+    QDir output;
+    QSize size = {1920, 1080};
+    int fps = 0;
+    int maxGap = 0;
+    QByteArray format;
+};
+
+static std::atomic<int> finishedFiles(0);
+static std::atomic<int> failedFiles(0);
+static std::atomic<qint64> totalFrames(0);
+
+static bool render(QString const & fileName, Options const & options)
+{
+    QFileInfo info(fileName);
+    QFile * file = new QFile(fileName);
+    if (!file->open(QFile::ReadOnly)) {
+        qWarning() << "open failed" << fileName << file->errorString();
+        delete file;
+        return false;
+    }
+    QByteArray format = options.format.isEmpty() ? info.suffix().toUtf8() : options.format;
+    StrokesReader * reader = StrokesReader::createReader(file, format);
+    if (reader == nullptr) {
+        qWarning() << "no reader for" << fileName << format;
+        delete file;
+        return false;
+    }
+    ImageStrokesRenderer renderer(reader, options.size);
+    if (options.fps <= 0) {
+        if (!renderer.renderAll()) {
+            qWarning() << "render failed" << fileName;
+            return false;
+        }
+        totalFrames += 1;
+        return renderer.image().save(options.output.filePath(info.completeBaseName() + ".png"));
+    }
+    QDir dir(options.output.filePath(info.completeBaseName()));
+    if (!dir.mkpath(".")) {
+        qWarning() << "mkpath failed" << dir.path();
+        return false;
+    }
+    renderer.setMaxGap(options.maxGap);
+    bool ok = true;
+    int index = 0;
+    int n = renderer.renderFrames(options.fps, [&] (QImage const & image, int) {
+        QString name = QString("%1.png").arg(index++, 6, 10, QChar('0'));
+        ok = image.save(dir.filePath(name));
+        return ok;
+    });
+    totalFrames += n;
+    return ok && renderer.isFinished();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("strokesrasterizer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render stroke files to PNG images or frame sequences");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"o", "output"}, "Output directory.", "dir", "."},
+        {{"s", "size"}, "Image size.", "WxH", "1920x1080"},
+        {{"f", "fps"}, "Frame sequence at fps, 0 for final image only.", "n", "0"},
+        {{"j", "jobs"}, "Parallel jobs.", "n", QString::number(QThread::idealThreadCount())},
+        {{"g", "max-gap"}, "Shorten pauses longer than ms.", "ms", "0"},
+        {"format", "Stroke format, default from file suffix.", "type"},
+    });
+    parser.addPositionalArgument("files", "Stroke files.", "files...");
+    parser.process(app);
+
+    Options options;
+    options.output = QDir(parser.value("output"));
+    QStringList size = parser.value("size").split('x');
+    if (size.size() == 2)
+        options.size = QSize(size[0].toInt(), size[1].toInt());
+    options.fps = parser.value("fps").toInt();
+    options.maxGap = parser.value("max-gap").toInt();
+    options.format = parser.value("format").toUtf8();
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty() || options.size.isEmpty()) {
+        parser.showHelp(1);
+    }
+    if (!options.output.mkpath(".")) {
+        qCritical() << "bad output directory" << options.output.path();
+        return 1;
+    }
+
+    // registry is not thread safe, initialize here
+    qInfo() << "formats" << StrokesReader::formats();
+    QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value("jobs").toInt()));
+
+    QElapsedTimer timer;
+    timer.start();
+    QtConcurrent::blockingMap(files, [&options] (QString const & file) {
+        if (render(file, options))
+            ++finishedFiles;
+        else
+            ++failedFiles;
+    });
+    qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    int finished = finishedFiles;
+    int failed = failedFiles;
+    qint64 frames = totalFrames;
+
+    qInfo().noquote() << QString("%1 files (%2 failed), %3 frames in %4 s: %5 files/s, %6 frames/s")
+                         .arg(finished).arg(failed).arg(frames)
+                         .arg(elapsed / 1000.0, 0, 'f', 3)
+                         .arg(finished * 1000.0 / elapsed, 0, 'f', 2)
+                         .arg(frames * 1000.0 / elapsed, 0, 'f', 2);
+    return failed ? 2 : 0;
+}
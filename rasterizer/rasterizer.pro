@@ -0,0 +1,30 @@
+# Standalone tool, not part of ShowBoard.pro (a lib project), build after it:
+#   qmake ShowBoard.pro && make
+#   qmake rasterizer/rasterizer.pro SHOWBOARD_LIBDIR=<dir of ShowBoard lib> && make
+# SHOWBOARD_LIBDIR defaults to parent of build dir, as when built in a
+#  subdir of ShowBoard build dir
+
+QT += gui concurrent
+
+TEMPLATE = app
+TARGET = strokesrasterizer
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+include($$(applyCommonConfig))
+include($$(applyConanPlugin))
+
+include(../../config.pri)
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/..
+
+isEmpty(SHOWBOARD_LIBDIR): SHOWBOARD_LIBDIR = $$(SHOWBOARD_LIBDIR)
+isEmpty(SHOWBOARD_LIBDIR): SHOWBOARD_LIBDIR = $$OUT_PWD/..
+
+LIBS += -L$$SHOWBOARD_LIBDIR -lShowBoard
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,248 @@
+#include "bufferedstrokeswriter.h"
+#include "core/workthread.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QDataStream>
+#include <QTimer>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static constexpr quint32 JOURNAL_MAGIC = 0x534a4e4c; // SJNL
+
+static WorkThread& thread()
+{
+    static WorkThread th("StrokesWriter");
+    return th;
+}
+
+struct Crc32Table
+{
+    quint32 table[256];
+
+    Crc32Table()
+    {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+};
+
+static quint32 crc32(char const * data, qint64 size, quint32 crc = 0)
+{
+    // thread safe initialization
+    static Crc32Table const crc32Table;
+    quint32 const * table = crc32Table.table;
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<uchar>(data[i])) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void syncFile(QFile & file)
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+}
+
+struct BufferedStrokesWriter::Sink
+{
+    QIODevice * stream = nullptr;
+    QFile * file = nullptr; // same as stream, if is local file
+    QFile journal;
+    qint64 offset = 0;
+    bool sync = true;
+    bool failed = false;
+
+    // on worker thread
+    void write(QByteArray const & block)
+    {
+        if (stream->write(block) != block.size()) {
+            qWarning() << "BufferedStrokesWriter write failed" << stream->errorString();
+            failed = true;
+            return;
+        }
+        if (file == nullptr)
+            return;
+        if (sync)
+            syncFile(*file);
+        else
+            file->flush();
+        QDataStream ds(&journal);
+        ds << JOURNAL_MAGIC << offset << static_cast<quint32>(block.size())
+           << crc32(block.constData(), block.size());
+        offset += block.size();
+        if (sync)
+            syncFile(journal);
+        else
+            journal.flush();
+    }
+};
+
+StrokesWriter *BufferedStrokesWriter::createWriter(QIODevice *stream, const QByteArray &format)
+{
+    QBuffer * buffer = new QBuffer;
+    buffer->open(QBuffer::ReadWrite);
+    StrokesWriter * writer = StrokesWriter::createWriter(buffer, format);
+    if (writer == nullptr) {
+        delete buffer;
+        return nullptr;
+    }
+    return new BufferedStrokesWriter(writer, buffer, stream);
+}
+
+qint64 BufferedStrokesWriter::recover(const QString &file)
+{
+    QFile journal(file + ".jnl");
+    // closed cleanly, or not written by us
+    if (!journal.exists() || !journal.open(QFile::ReadWrite))
+        return -1;
+    QFile data(file);
+    if (!data.open(QFile::ReadWrite))
+        return -1;
+    QDataStream ds(&journal);
+    qint64 valid = 0;
+    qint64 journalValid = 0;
+    while (!ds.atEnd()) {
+        quint32 magic = 0, size = 0, crc = 0;
+        qint64 offset = 0;
+        ds >> magic >> offset >> size >> crc;
+        if (ds.status() != QDataStream::Ok || magic != JOURNAL_MAGIC || offset != valid)
+            break;
+        if (!data.seek(offset))
+            break;
+        QByteArray block = data.read(size);
+        if (block.size() != static_cast<int>(size) || crc32(block.constData(), size) != crc)
+            break;
+        valid += size;
+        journalValid = journal.pos();
+    }
+    if (data.size() != valid) {
+        qWarning() << "BufferedStrokesWriter recover" << file << data.size() << "->" << valid;
+        data.resize(valid);
+    }
+    if (journal.size() != journalValid)
+        journal.resize(journalValid);
+    return valid;
+}
+
+BufferedStrokesWriter::BufferedStrokesWriter(StrokesWriter * writer, QBuffer * buffer, QIODevice * stream, QObject *parent)
+    : StrokesWriter(stream, parent)
+    , writer_(writer)
+    , buffer_(buffer)
+    , timer_(new QTimer(this))
+    , sink_(new Sink)
+{
+    writer->setParent(this);
+    buffer->setParent(this);
+    sink_->stream = stream;
+    sink_->file = qobject_cast<QFile*>(stream);
+    if (sink_->file) {
+        sink_->offset = sink_->file->pos();
+        sink_->journal.setFileName(sink_->file->fileName() + ".jnl");
+        if (!sink_->journal.open(sink_->offset ? QFile::Append : QFile::WriteOnly)) {
+            qWarning() << "BufferedStrokesWriter no journal" << sink_->journal.errorString();
+            sink_->file = nullptr;
+        }
+    }
+    timer_->setSingleShot(true);
+    timer_->setInterval(500);
+    connect(timer_, &QTimer::timeout, this, &BufferedStrokesWriter::commit);
+}
+
+BufferedStrokesWriter::~BufferedStrokesWriter()
+{
+    close();
+}
+
+void BufferedStrokesWriter::setThreshold(int size, int time)
+{
+    size_ = size;
+    timer_->setInterval(time);
+}
+
+void BufferedStrokesWriter::setSync(bool sync)
+{
+    QSharedPointer<Sink> sink = sink_;
+    thread().postWork([sink, sync] () {
+        sink->sync = sync;
+    });
+}
+
+bool BufferedStrokesWriter::setMaximun(StrokePoint &max)
+{
+    if (!writer_->setMaximun(max))
+        return false;
+    commit();
+    return true;
+}
+
+bool BufferedStrokesWriter::write(StrokePoint &point)
+{
+    if (!writer_->write(point))
+        return false;
+    if (point.s || buffer_->size() >= size_)
+        commit();
+    else if (!timer_->isActive())
+        timer_->start();
+    return true;
+}
+
+bool BufferedStrokesWriter::flush()
+{
+    commit();
+    return true;
+}
+
+void BufferedStrokesWriter::close()
+{
+    if (!sink_)
+        return;
+    writer_->close(); // flush inner writer into buffer
+    commit();
+    QSharedPointer<Sink> sink = sink_;
+    sink_.reset();
+    thread().sendWork([sink] () {
+        if (sink->file && !sink->failed) {
+            // all blocks are in file, journal is only for crash recovery
+            syncFile(*sink->file);
+            sink->file->close();
+            if (sink->file->error() == QFile::NoError) {
+                sink->journal.remove();
+                return;
+            }
+        }
+        sink->stream->close();
+        sink->journal.close();
+    });
+}
+
+void BufferedStrokesWriter::commit()
+{
+    timer_->stop();
+    if (!sink_)
+        return;
+    writer_->flush(); // points held by inner writer, spz block
+    if (buffer_->size() == 0)
+        return;
+    QByteArray block = buffer_->data();
+    buffer_->buffer().clear();
+    if (buffer_->isOpen())
+        buffer_->seek(0);
+    QSharedPointer<Sink> sink = sink_;
+    thread().postWork([sink, block] () {
+        sink->write(block);
+    });
+}
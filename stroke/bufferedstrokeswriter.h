@@ -0,0 +1,68 @@
+#ifndef BUFFEREDSTROKESWRITER_H
+#define BUFFEREDSTROKESWRITER_H
+
+#include "strokeswriter.h"
+
+#include <QSharedPointer>
+
+class QBuffer;
+class QTimer;
+
+/*
+ * Group commit decorator of any registered StrokesWriter
+ *  points are encoded into memory, and committed as blocks on worker thread
+ *  when stroke ends, or block size/time threshold is reached
+ *  for local files, each block is appended to journal "<file>.jnl" with its
+ *  offset, size and crc32 after synced, recover() truncates file to the
+ *  last valid block, so at most one block is lost on power loss; journal is
+ *  removed after clean close()
+ */
+
+class SHOWBOARD_EXPORT BufferedStrokesWriter : public StrokesWriter
+{
+    Q_OBJECT
+public:
+    static StrokesWriter * createWriter(QIODevice * stream, QByteArray const & format);
+
+    // truncate file to last valid block in journal, return valid size, -1 if
+    //  no journal (closed cleanly)
+    static qint64 recover(QString const & file);
+
+public:
+    // take ownership of writer, whose stream should be buffer
+    BufferedStrokesWriter(StrokesWriter * writer, QBuffer * buffer, QIODevice * stream, QObject *parent = nullptr);
+
+    virtual ~BufferedStrokesWriter() override;
+
+public:
+    // commit when buffered bytes exceed size, or after time (ms)
+    void setThreshold(int size, int time);
+
+    // sync (fsync) file and journal for each block
+    void setSync(bool sync);
+
+public:
+    virtual bool setMaximun(StrokePoint & max) override;
+
+    virtual bool write(StrokePoint & point) override;
+
+    // commit now
+    virtual bool flush() override;
+
+    virtual void close() override;
+
+public:
+    void commit();
+
+public:
+    struct Sink;
+
+private:
+    StrokesWriter * writer_;
+    QBuffer * buffer_;
+    QTimer * timer_;
+    int size_ = 4096;
+    QSharedPointer<Sink> sink_;
+};
+
+#endif // BUFFEREDSTROKESWRITER_H
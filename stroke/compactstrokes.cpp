@@ -0,0 +1,308 @@
+#include "compactstrokes.h"
+#include "varint.h"
+
+#include <qexport.h>
+
+#include <QIODevice>
+#include <QtEndian>
+#include <QFile>
+#include <QDebug>
+
+#include <algorithm>
+
+REGISTER_STROKE_READER(CompactStrokesReader, "spz")
+REGISTER_STROKE_WRITER(CompactStrokesWriter, "spz")
+
+static constexpr char MAGIC[] = {'S', 'P', 'Z', 2};
+static constexpr int HEAD_SIZE = sizeof(MAGIC) + sizeof(StrokePoint);
+static constexpr int BLOCK_POINTS = 256;
+static constexpr char TRAILER_MAGIC[] = {'S', 'P', 'Z', 'E'};
+static constexpr int TRAILER_SIZE = 20 + sizeof(TRAILER_MAGIC);
+
+static void putMetadata(QByteArray & out, StrokesMetadata const & meta)
+{
+    char data[TRAILER_SIZE];
+    qToLittleEndian<qint32>(meta.duration, data);
+    qToLittleEndian<qint32>(meta.pointCount, data + 4);
+    qToLittleEndian<qint32>(meta.strokeCount, data + 8);
+    QRect bounds = meta.bounds.isValid() ? meta.bounds : QRect(0, 0, 0, 0);
+    qToLittleEndian<quint16>(static_cast<quint16>(bounds.left()), data + 12);
+    qToLittleEndian<quint16>(static_cast<quint16>(bounds.top()), data + 14);
+    qToLittleEndian<quint16>(static_cast<quint16>(bounds.right()), data + 16);
+    qToLittleEndian<quint16>(static_cast<quint16>(bounds.bottom()), data + 18);
+    memcpy(data + 20, TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+    out.append(data, TRAILER_SIZE);
+}
+
+static bool getMetadata(char const * data, StrokesMetadata & meta)
+{
+    if (memcmp(data + 20, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0)
+        return false;
+    meta.valid = true;
+    meta.duration = qFromLittleEndian<qint32>(data);
+    meta.pointCount = qFromLittleEndian<qint32>(data + 4);
+    meta.strokeCount = qFromLittleEndian<qint32>(data + 8);
+    if (meta.pointCount > 0 && meta.strokeCount > 0)
+        meta.bounds = QRect(QPoint(qFromLittleEndian<quint16>(data + 12),
+                                   qFromLittleEndian<quint16>(data + 14)),
+                            QPoint(qFromLittleEndian<quint16>(data + 16),
+                                   qFromLittleEndian<quint16>(data + 18)));
+    return true;
+}
+
+/* CompactStrokesReader */
+
+CompactStrokesReader::CompactStrokesReader(QIODevice * stream, QObject *parent)
+    : StrokesReader(stream, parent)
+{
+}
+
+bool CompactStrokesReader::getMaximun(StrokePoint &max)
+{
+    char head[HEAD_SIZE];
+    if (stream_->read(head, HEAD_SIZE) != HEAD_SIZE
+            || memcmp(head, MAGIC, sizeof(MAGIC)) != 0) {
+        qWarning() << "CompactStrokesReader bad head";
+        return false;
+    }
+    memcpy(max.data(), head + sizeof(MAGIC), sizeof(max));
+    dataStart_ = HEAD_SIZE;
+    if (blocks_.isEmpty())
+        blocks_.append(dataStart_);
+    blockCount_ = blockIndex_ = 0;
+    nextBlock_ = dataStart_;
+    return true;
+}
+
+bool CompactStrokesReader::seek(int bytePos)
+{
+    blockCount_ = blockIndex_ = 0;
+    if (dataStart_ == 0 || bytePos <= dataStart_) {
+        // before head is read, or to the first block
+        nextBlock_ = bytePos;
+        return stream_->seek(bytePos);
+    }
+    auto iter = std::upper_bound(blocks_.begin(), blocks_.end(), bytePos);
+    int pos = *--iter;
+    while (true) {
+        if (!loadBlock(pos))
+            return false;
+        if (bytePos - blockStart_ <= blockCount_)
+            break;
+        if (bytePos < nextBlock_)
+            return false; // not a point position
+        pos = nextBlock_;
+    }
+    StrokePoint point;
+    for (int n = bytePos - blockStart_; n > 0; --n)
+        decodePoint(point);
+    return true;
+}
+
+int CompactStrokesReader::bytePos()
+{
+    if (blockCount_ == 0)
+        return nextBlock_;
+    return blockStart_ + blockIndex_;
+}
+
+bool CompactStrokesReader::read(StrokePoint &point, int &bytePos)
+{
+    if (blockIndex_ >= blockCount_ && !loadBlock(nextBlock_))
+        return false;
+    if (!decodePoint(point))
+        return false;
+    bytePos = blockStart_ + blockIndex_;
+    return true;
+}
+
+int CompactStrokesReader::readBatch(StrokePoint *points, int *bytePoses, int count)
+{
+    int n = 0;
+    while (n < count) {
+        if (blockIndex_ >= blockCount_ && !loadBlock(nextBlock_))
+            break;
+        int e = qMin(count, n + blockCount_ - blockIndex_);
+        for (; n < e; ++n) {
+            if (!decodePoint(points[n]))
+                return n;
+            if (bytePoses)
+                bytePoses[n] = blockStart_ + blockIndex_;
+        }
+    }
+    return n;
+}
+
+bool CompactStrokesReader::atEnd()
+{
+    return end_ >= 0 && blockIndex_ >= blockCount_ && nextBlock_ == end_;
+}
+
+bool CompactStrokesReader::startAsyncRead(AsyncHandler handler)
+{
+    // stream may not end after trailer, local file never signals its end
+    if (atEnd())
+        return false;
+    if (!StrokesReader::startAsyncRead(handler))
+        return false;
+    // after base handler has read available points
+    connect(stream_, &QIODevice::readyRead, this, [this] () {
+        if (atEnd())
+            emit asyncFinished();
+    });
+    return true;
+}
+
+bool CompactStrokesReader::getMetadata(StrokesMetadata &meta)
+{
+    // seek on network streams reconnects, leave them to background scan
+    if (!meta_.valid && qobject_cast<QFile*>(stream_)) {
+        qint64 size = stream_->size();
+        if (size < HEAD_SIZE + TRAILER_SIZE)
+            return false;
+        qint64 pos = stream_->pos();
+        char data[TRAILER_SIZE];
+        bool ok = stream_->seek(size - TRAILER_SIZE)
+                && stream_->read(data, TRAILER_SIZE) == TRAILER_SIZE
+                && ::getMetadata(data, meta_);
+        stream_->seek(pos);
+        if (!ok)
+            return false;
+    }
+    meta = meta_;
+    return meta_.valid;
+}
+
+// load whole block, keep stream untouched if not fully available
+bool CompactStrokesReader::loadBlock(int pos)
+{
+    if (pos == end_)
+        return false;
+    if (stream_->pos() != pos && !stream_->seek(pos))
+        return false;
+    QByteArray head = stream_->peek(10);
+    uchar const * p = reinterpret_cast<uchar const *>(head.constData());
+    uchar const * end = p + head.size();
+    quint32 size = 0, count = 0;
+    if (!getVarint(p, end, size) || !getVarint(p, end, count))
+        return false;
+    int headSize = static_cast<int>(p - reinterpret_cast<uchar const *>(head.constData()));
+    if (count == 0 && size == TRAILER_SIZE) {
+        // trailer, end of points, consume it so that stream is at end too
+        if (stream_->bytesAvailable() < headSize + TRAILER_SIZE)
+            return false;
+        QByteArray data = stream_->read(headSize + TRAILER_SIZE);
+        ::getMetadata(data.constData() + headSize, meta_);
+        end_ = pos;
+        return false;
+    }
+    if (count == 0 || count > BLOCK_POINTS || size < sizeof(StrokePoint))
+        return false;
+    if (stream_->bytesAvailable() < headSize + static_cast<qint64>(size))
+        return false;
+    stream_->skip(headSize);
+    block_ = stream_->read(size);
+    if (block_.size() != static_cast<int>(size))
+        return false;
+    blockStart_ = pos;
+    blockCount_ = static_cast<int>(count);
+    blockIndex_ = 0;
+    blockOffset_ = 0;
+    nextBlock_ = pos + headSize + static_cast<int>(size);
+    if (blocks_.isEmpty() || pos > blocks_.last())
+        blocks_.append(pos);
+    return true;
+}
+
+bool CompactStrokesReader::decodePoint(StrokePoint &point)
+{
+    uchar const * p = reinterpret_cast<uchar const *>(block_.constData()) + blockOffset_;
+    uchar const * end = reinterpret_cast<uchar const *>(block_.constData()) + block_.size();
+    if (blockIndex_ == 0) {
+        memcpy(point.data(), p, sizeof(point));
+        p += sizeof(point);
+        delta_.start(point);
+    } else if (!delta_.get(p, end, point)) {
+        qWarning() << "CompactStrokesReader bad block" << blockStart_;
+        blockCount_ = blockIndex_; // stop at this block
+        return false;
+    }
+    blockOffset_ = static_cast<int>(p - reinterpret_cast<uchar const *>(block_.constData()));
+    ++blockIndex_;
+    return true;
+}
+
+/* CompactStrokesWriter */
+
+CompactStrokesWriter::CompactStrokesWriter(QIODevice * stream, QObject *parent)
+    : StrokesWriter(stream, parent)
+{
+}
+
+CompactStrokesWriter::~CompactStrokesWriter()
+{
+    // base destructor only closes stream
+    if (stream_->isOpen())
+        finish();
+}
+
+bool CompactStrokesWriter::setMaximun(StrokePoint &max)
+{
+    meta_.reset(new StrokesMetadataBuilder(max));
+    return stream_->write(MAGIC, sizeof(MAGIC)) == sizeof(MAGIC)
+            && stream_->write(max.data(), sizeof(max)) == sizeof(max);
+}
+
+bool CompactStrokesWriter::write(StrokePoint &point)
+{
+    if (blockCount_ == 0) {
+        block_.append(point.data(), sizeof(point));
+        delta_.start(point);
+    } else {
+        delta_.put(block_, point);
+    }
+    if (meta_)
+        meta_->add(point);
+    if (++blockCount_ < BLOCK_POINTS)
+        return true;
+    return flushBlock();
+}
+
+bool CompactStrokesWriter::flush()
+{
+    return flushBlock();
+}
+
+void CompactStrokesWriter::close()
+{
+    if (stream_->isOpen())
+        finish();
+    StrokesWriter::close();
+}
+
+bool CompactStrokesWriter::flushBlock()
+{
+    if (blockCount_ == 0)
+        return true;
+    QByteArray head;
+    putVarint(head, static_cast<quint32>(block_.size()));
+    putVarint(head, static_cast<quint32>(blockCount_));
+    bool ok = stream_->write(head) == head.size()
+            && stream_->write(block_) == block_.size();
+    block_.clear();
+    blockCount_ = 0;
+    return ok;
+}
+
+bool CompactStrokesWriter::finish()
+{
+    bool ok = flushBlock();
+    if (!meta_)
+        return ok;
+    QByteArray trailer;
+    putVarint(trailer, TRAILER_SIZE);
+    putVarint(trailer, 0);
+    putMetadata(trailer, meta_->result());
+    meta_.reset();
+    return stream_->write(trailer) == trailer.size() && ok;
+}
@@ -0,0 +1,99 @@
+#ifndef COMPACTSTROKES_H
+#define COMPACTSTROKES_H
+
+#include "strokesreader.h"
+#include "strokeswriter.h"
+#include "strokedelta.h"
+
+#include <QVector>
+#include <QScopedPointer>
+
+/*
+ * Compact stroke format (spz)
+ *  head: "SPZ" version(2), maximun point (8 bytes)
+ *  blocks: varint payload size, varint point count, payload
+ *  payload: first point absolute (8 bytes) as resync point, then deltas
+ *  delta: see StrokeDelta, 1 to 3 bytes for most points
+ *
+ * Byte position of point is block start + index of point in block (1 based),
+ *  that is always less than next block start, so seek keeps working
+ *
+ * Trailer: a block with point count 0, payload is metadata (int32 duration,
+ *  point count, stroke count, ushort bounds left, top, right, bottom) and
+ *  "SPZE", so metadata of finished files is read from last 24 bytes; points
+ *  end at trailer, async reading finishes there without stream end
+ */
+
+class SHOWBOARD_EXPORT CompactStrokesReader : public StrokesReader
+{
+    Q_OBJECT
+public:
+    Q_INVOKABLE CompactStrokesReader(QIODevice * stream, QObject *parent = nullptr);
+
+public:
+    virtual bool getMaximun(StrokePoint & max) override;
+
+    virtual bool seek(int bytePos) override;
+
+    virtual int bytePos() override;
+
+    virtual bool read(StrokePoint & point, int & bytePos) override;
+
+    virtual int readBatch(StrokePoint * points, int * bytePoses, int count) override;
+
+    virtual bool atEnd() override;
+
+    virtual bool startAsyncRead(AsyncHandler handler) override;
+
+    virtual bool getMetadata(StrokesMetadata & meta) override;
+
+private:
+    bool loadBlock(int pos);
+
+    bool decodePoint(StrokePoint & point);
+
+private:
+    int dataStart_ = 0;
+    QVector<int> blocks_; // known block starts
+    QByteArray block_;
+    int blockStart_ = 0;
+    int blockCount_ = 0;
+    int blockIndex_ = 0;
+    int blockOffset_ = 0;
+    int nextBlock_ = 0;
+    int end_ = -1; // trailer start, when trailer is read
+    StrokeDelta delta_;
+    StrokesMetadata meta_;
+};
+
+class SHOWBOARD_EXPORT CompactStrokesWriter : public StrokesWriter
+{
+    Q_OBJECT
+public:
+    Q_INVOKABLE CompactStrokesWriter(QIODevice * stream, QObject *parent = nullptr);
+
+    virtual ~CompactStrokesWriter() override;
+
+public:
+    virtual bool setMaximun(StrokePoint & max) override;
+
+    virtual bool write(StrokePoint & point) override;
+
+    // write partial block
+    virtual bool flush() override;
+
+    virtual void close() override;
+
+private:
+    bool flushBlock();
+
+    bool finish();
+
+private:
+    QByteArray block_;
+    int blockCount_ = 0;
+    StrokeDelta delta_;
+    QScopedPointer<StrokesMetadataBuilder> meta_;
+};
+
+#endif // COMPACTSTROKES_H
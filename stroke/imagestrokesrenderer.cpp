@@ -0,0 +1,159 @@
+#include "imagestrokesrenderer.h"
+#include "strokesclock.h"
+
+ImageStrokesRenderer::ImageStrokesRenderer(StrokesReader *reader, const QSize &size, QObject *parent)
+    : StrokesRenderer(reader, parent)
+    , clock_(new StrokesClock(this))
+    , image_(size, QImage::Format_ARGB32_Premultiplied)
+{
+    clock_->setMode(StrokesClock::VirtualMode);
+    setClock(clock_);
+    // may run on pool threads, duration is played range then
+    setScanMetadata(false);
+    image_.fill(background_);
+}
+
+ImageStrokesRenderer::~ImageStrokesRenderer()
+{
+    if (painter_.isActive())
+        painter_.end();
+}
+
+void ImageStrokesRenderer::setBackground(const QColor &color)
+{
+    background_ = color;
+    if (!isStarted())
+        image_.fill(background_);
+}
+
+void ImageStrokesRenderer::setPen(const QColor &color, qreal width)
+{
+    color_ = color;
+    width_ = width;
+}
+
+bool ImageStrokesRenderer::renderAll()
+{
+    setRate(0);
+    if (!isStarted() && !start())
+        return false;
+    // fast mode reschedule at same virtual time until finished
+    clock_->advance(0);
+    return isFinished();
+}
+
+int ImageStrokesRenderer::renderFrames(int fps, std::function<bool (const QImage &, int)> frame)
+{
+    if (fps <= 0)
+        return 0;
+    setRate(1);
+    if (!isStarted() && !start())
+        return 0;
+    int n = 0;
+    int time = 0;
+    while (true) {
+        int next = n * 1000 / fps; // no drift with fps not dividing 1000
+        clock_->advance(next - time);
+        time = next;
+        ++n;
+        // also stop one frame after last point, if reader does not end
+        if (!frame(image_, time) || isFinished() || time > duration() + 1000 / fps)
+            break;
+    }
+    return n;
+}
+
+void ImageStrokesRenderer::setMaximun(const StrokePoint &max)
+{
+    scaleX_ = max.x ? static_cast<qreal>(image_.width()) / max.x : 1;
+    scaleY_ = max.y ? static_cast<qreal>(image_.height()) / max.y : 1;
+    scaleP_ = max.p ? width_ / max.p : 0;
+    begin();
+}
+
+void ImageStrokesRenderer::startStroke(const StrokePoint &point)
+{
+    begin(); // may replay after finish
+    last_ = map(point);
+    painter_.setPen(Qt::NoPen);
+    painter_.setBrush(color_);
+    qreal r = width(point) / 2;
+    painter_.drawEllipse(last_, r, r);
+}
+
+void ImageStrokesRenderer::addPoint(const StrokePoint &point)
+{
+    QPointF pt = map(point);
+    painter_.setPen(QPen(color_, width(point), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter_.drawLine(last_, pt);
+    last_ = pt;
+}
+
+void ImageStrokesRenderer::addPoints(const StrokePoint *points, int count)
+{
+    // same width for whole run if no pressure
+    if (scaleP_ > 0) {
+        StrokesRenderer::addPoints(points, count);
+        return;
+    }
+    QPolygonF line;
+    line.reserve(count + 1);
+    line.append(last_);
+    for (int i = 0; i < count; ++i)
+        line.append(map(points[i]));
+    painter_.setPen(QPen(color_, width_, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter_.drawPolyline(line);
+    last_ = line.last();
+}
+
+void ImageStrokesRenderer::endStroke()
+{
+}
+
+void ImageStrokesRenderer::onFinish()
+{
+    if (painter_.isActive())
+        painter_.end();
+}
+
+bool ImageStrokesRenderer::saveSnapshot(QImage &image)
+{
+    image = image_.copy();
+    return true;
+}
+
+void ImageStrokesRenderer::restoreSnapshot(const QImage &image)
+{
+    bool active = painter_.isActive();
+    if (active)
+        painter_.end();
+    if (image.isNull())
+        image_.fill(background_);
+    else
+        image_ = image.copy();
+    if (active)
+        begin();
+}
+
+void ImageStrokesRenderer::clearInk()
+{
+    restoreSnapshot(QImage());
+}
+
+void ImageStrokesRenderer::begin()
+{
+    if (!painter_.isActive()) {
+        painter_.begin(&image_);
+        painter_.setRenderHint(QPainter::Antialiasing);
+    }
+}
+
+QPointF ImageStrokesRenderer::map(const StrokePoint &point) const
+{
+    return QPointF(point.x * scaleX_, point.y * scaleY_);
+}
+
+qreal ImageStrokesRenderer::width(const StrokePoint &point) const
+{
+    return scaleP_ > 0 ? qMax(point.p * scaleP_, 0.5) : width_;
+}
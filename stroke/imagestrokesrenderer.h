@@ -0,0 +1,83 @@
+#ifndef IMAGESTROKESRENDERER_H
+#define IMAGESTROKESRENDERER_H
+
+#include "strokesrenderer.h"
+
+#include <QPainter>
+#include <QColor>
+
+#include <functional>
+
+class StrokesClock;
+
+/*
+ * Headless renderer, paint strokes into QImage of given size
+ *  played on own virtual clock, so no event loop or display is needed,
+ *  safe to use one instance per worker thread
+ */
+
+class SHOWBOARD_EXPORT ImageStrokesRenderer : public StrokesRenderer
+{
+    Q_OBJECT
+public:
+    ImageStrokesRenderer(StrokesReader * reader, QSize const & size, QObject *parent = nullptr);
+
+    virtual ~ImageStrokesRenderer() override;
+
+public:
+    QImage const & image() const { return image_; }
+
+    // transparent by default
+    void setBackground(QColor const & color);
+
+    // width in image pixels at max pressure
+    void setPen(QColor const & color, qreal width);
+
+public:
+    // render all points as fast as possible, return false if not finished
+    bool renderAll();
+
+    // play in real time and call frame at fps, stop if frame return false
+    //  return number of frames
+    int renderFrames(int fps, std::function<bool (QImage const & image, int time)> frame);
+
+protected:
+    virtual void setMaximun(StrokePoint const & max) override;
+
+    virtual void startStroke(StrokePoint const & point) override;
+
+    virtual void addPoint(StrokePoint const & point) override;
+
+    virtual void addPoints(StrokePoint const * points, int count) override;
+
+    virtual void endStroke() override;
+
+    virtual void onFinish() override;
+
+    virtual bool saveSnapshot(QImage & image) override;
+
+    virtual void restoreSnapshot(QImage const & image) override;
+
+    virtual void clearInk() override;
+
+private:
+    void begin();
+
+    QPointF map(StrokePoint const & point) const;
+
+    qreal width(StrokePoint const & point) const;
+
+private:
+    StrokesClock * clock_;
+    QImage image_;
+    QPainter painter_;
+    QColor background_ = Qt::transparent;
+    QColor color_ = Qt::black;
+    qreal width_ = 2;
+    qreal scaleX_ = 1;
+    qreal scaleY_ = 1;
+    qreal scaleP_ = 0;
+    QPointF last_;
+};
+
+#endif // IMAGESTROKESRENDERER_H
@@ -0,0 +1,104 @@
+#include "inkpredictor.h"
+
+#include <QLineF>
+
+// weight of newest sample in smoothed velocity and acceleration
+static constexpr qreal SMOOTH = 0.5;
+// no prediction after a pause longer than this (ms)
+static constexpr qreal MAX_INTERVAL = 50;
+// no prediction below this speed (px per ms)
+static constexpr qreal MIN_SPEED = 0.05;
+
+InkPredictor::InkPredictor(int horizon, qreal maxDistance)
+    : horizon_(horizon)
+    , maxDistance_(maxDistance)
+{
+}
+
+void InkPredictor::reset()
+{
+    count_ = 0;
+    velocity_ = acceleration_ = QPointF();
+}
+
+void InkPredictor::addPoint(const QPointF &point, qreal time)
+{
+    qreal dt = time - lastTime_;
+    if (count_ == 0 || dt > MAX_INTERVAL) {
+        count_ = 1;
+        velocity_ = acceleration_ = QPointF();
+    } else if (dt > 0) {
+        QPointF velocity = (point - last_) / dt;
+        if (count_ == 1) {
+            velocity_ = velocity;
+        } else {
+            QPointF acceleration = (velocity - velocity_) / dt;
+            acceleration_ = acceleration_ * (1 - SMOOTH) + acceleration * SMOOTH;
+            velocity_ = velocity_ * (1 - SMOOTH) + velocity * SMOOTH;
+        }
+        ++count_;
+    } else {
+        // same time (coalesced without time), keep estimation
+        return;
+    }
+    last_ = point;
+    lastTime_ = time;
+}
+
+QPolygonF InkPredictor::predict(int steps) const
+{
+    QPolygonF tail;
+    if (count_ < 3 || horizon_ <= 0 || steps <= 0)
+        return tail;
+    qreal speed = QLineF(QPointF(), velocity_).length();
+    if (speed < MIN_SPEED)
+        return tail;
+    qreal length = 0;
+    QPointF prev = last_;
+    for (int i = 1; i <= steps; ++i) {
+        qreal t = static_cast<qreal>(horizon_) * i / steps;
+        QPointF pt = last_ + velocity_ * t + acceleration_ * (t * t / 2);
+        // don't turn back, deceleration only shortens the tail
+        if (QPointF::dotProduct(pt - prev, velocity_) <= 0)
+            break;
+        qreal d = QLineF(prev, pt).length();
+        if (length + d > maxDistance_) {
+            tail.append(prev + (pt - prev) * ((maxDistance_ - length) / d));
+            break;
+        }
+        length += d;
+        tail.append(pt);
+        prev = pt;
+    }
+    return tail;
+}
+
+InkLatency::InkLatency()
+{
+    clock_.start();
+}
+
+void InkLatency::input()
+{
+    if (pending_ < 0)
+        pending_ = clock_.nsecsElapsed();
+}
+
+void InkLatency::painted()
+{
+    if (pending_ < 0)
+        return;
+    last_ = clock_.nsecsElapsed() - pending_;
+    pending_ = -1;
+    ++count_;
+    total_ += last_;
+    if (last_ > max_)
+        max_ = last_;
+}
+
+void InkLatency::reset()
+{
+    pending_ = -1;
+    count_ = 0;
+    total_ = max_ = last_ = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef INKPREDICTOR_H
+#define INKPREDICTOR_H
+
+#include "ShowBoard_global.h"
+
+#include <QPolygonF>
+#include <QElapsedTimer>
+
+/*
+ * Predict short extension of stroke in progress, to hide input latency
+ *  velocity and acceleration are estimated from recent points (smoothed),
+ *  extension covers horizon ms and is limited in length; it is drawn as
+ *  tail of InkSurface and replaced when real points arrive
+ */
+
+class SHOWBOARD_EXPORT InkPredictor
+{
+public:
+    InkPredictor(int horizon = 16, qreal maxDistance = 24);
+
+public:
+    void setHorizon(int horizon) { horizon_ = horizon; }
+
+    void setMaxDistance(qreal distance) { maxDistance_ = distance; }
+
+    void reset();
+
+    // time in ms, of input event
+    void addPoint(QPointF const & point, qreal time);
+
+    // empty if too few points, too slow or paused
+    QPolygonF predict(int steps = 3) const;
+
+private:
+    int horizon_;
+    qreal maxDistance_;
+    int count_ = 0;
+    QPointF last_;
+    qreal lastTime_ = 0;
+    QPointF velocity_;
+    QPointF acceleration_;
+};
+
+/*
+ * Handler to pixel latency, from handling input to end of painting it; time
+ *  before event is handled is not included, event timestamps are not on a
+ *  comparable clock on all platforms
+ *  input() keeps oldest input not painted yet, painted() takes one sample
+ */
+
+class SHOWBOARD_EXPORT InkLatency
+{
+public:
+    InkLatency();
+
+public:
+    void input();
+
+    void painted();
+
+    void reset();
+
+public:
+    int count() const { return count_; }
+
+    // ms
+    qreal average() const { return count_ ? total_ / count_ / 1000000.0 : 0; }
+
+    qreal maximum() const { return max_ / 1000000.0; }
+
+    qreal last() const { return last_ / 1000000.0; }
+
+private:
+    QElapsedTimer clock_;
+    qint64 pending_ = -1;
+    int count_ = 0;
+    qint64 total_ = 0;
+    qint64 max_ = 0;
+    qint64 last_ = 0;
+};
+
+#endif // INKPREDICTOR_H
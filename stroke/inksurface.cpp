@@ -0,0 +1,243 @@
+#include "inksurface.h"
+
+#include <QPainter>
+#include <QPaintDevice>
+#include <QtMath>
+
+static quint32 tileKey(int x, int y)
+{
+    return (static_cast<quint32>(static_cast<quint16>(x)) << 16) | static_cast<quint16>(y);
+}
+
+static int tileX(quint32 key)
+{
+    return static_cast<qint16>(key >> 16);
+}
+
+static int tileY(quint32 key)
+{
+    return static_cast<qint16>(key & 0xffff);
+}
+
+InkSurface::InkSurface(int tileSize)
+    : tileSize_(tileSize)
+{
+}
+
+InkSurface::~InkSurface()
+{
+}
+
+void InkSurface::setPen(const QColor &color, qreal width)
+{
+    color_ = color;
+    width_ = width;
+}
+
+QRectF InkSurface::setScale(qreal scale)
+{
+    scale = qBound(0.25, qRound(scale * 4) / 4.0, 4.0);
+    if (qFuzzyCompare(scale, scale_))
+        return QRectF();
+    scale_ = scale;
+    int size = qCeil(tileSize_ * scale_);
+    for (Tiles * tiles : {&tiles_, &liveTiles_}) {
+        for (QImage & image : *tiles)
+            image = image.scaled(size, size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return bounds();
+}
+
+qreal InkSurface::deviceScale(QPainter *painter)
+{
+    qreal zoom = qSqrt(qAbs(painter->worldTransform().determinant()));
+    return painter->device()->devicePixelRatioF() * zoom;
+}
+
+QRectF InkSurface::startStroke(const QPointF &point, qreal width)
+{
+    QRectF dirty;
+    if (drawing_)
+        dirty = endStroke();
+    drawing_ = true;
+    last_ = point;
+    lastWidth_ = width > 0 ? width : width_;
+    liveBounds_ = QRectF();
+    return dirty | drawSegment(point, point, lastWidth_);
+}
+
+QRectF InkSurface::addPoint(const QPointF &point, qreal width)
+{
+    if (!drawing_)
+        return startStroke(point, width);
+    if (width <= 0)
+        width = width_;
+    QRectF dirty = drawSegment(last_, point, (lastWidth_ + width) / 2);
+    last_ = point;
+    lastWidth_ = width;
+    return dirty;
+}
+
+QRectF InkSurface::addPoints(const QPolygonF &points)
+{
+    QRectF dirty;
+    for (QPointF const & pt : points)
+        dirty |= addPoint(pt);
+    return dirty;
+}
+
+QRectF InkSurface::setTail(const QPolygonF &tail)
+{
+    if (tail_.isEmpty() && tail.isEmpty())
+        return QRectF();
+    qreal margin = lastWidth_ / 2 + 1;
+    QRectF dirty;
+    if (!tail_.isEmpty())
+        dirty = tail_.boundingRect().adjusted(-margin, -margin, margin, margin);
+    tail_ = tail;
+    if (!tail_.isEmpty()) {
+        tail_.prepend(last_);
+        dirty |= tail_.boundingRect().adjusted(-margin, -margin, margin, margin);
+    }
+    return dirty;
+}
+
+QRectF InkSurface::endStroke()
+{
+    if (!drawing_)
+        return QRectF();
+    QRectF dirty = setTail(QPolygonF());
+    for (auto it = liveTiles_.begin(); it != liveTiles_.end(); ++it) {
+        QImage & image = tile(tiles_, tileX(it.key()), tileY(it.key()));
+        QPainter painter(&image);
+        painter.setOpacity(color_.alphaF());
+        painter.drawImage(0, 0, it.value());
+    }
+    liveTiles_.clear();
+    bounds_ |= liveBounds_;
+    dirty |= liveBounds_;
+    liveBounds_ = QRectF();
+    drawing_ = false;
+    return dirty;
+}
+
+QRectF InkSurface::cancelStroke()
+{
+    if (!drawing_)
+        return QRectF();
+    QRectF dirty = setTail(QPolygonF()) | liveBounds_;
+    liveTiles_.clear();
+    liveBounds_ = QRectF();
+    drawing_ = false;
+    return dirty;
+}
+
+QRectF InkSurface::clear()
+{
+    QRectF dirty = bounds();
+    if (!tail_.isEmpty())
+        dirty |= setTail(QPolygonF());
+    tiles_.clear();
+    liveTiles_.clear();
+    bounds_ = liveBounds_ = QRectF();
+    drawing_ = false;
+    return dirty;
+}
+
+QRectF InkSurface::bounds() const
+{
+    return bounds_ | liveBounds_;
+}
+
+void InkSurface::paint(QPainter *painter, const QRectF &exposed) const
+{
+    QRect range = tileRange(exposed & bounds());
+    if (!range.isEmpty()) {
+        paint(painter, tiles_, range);
+        if (!liveTiles_.isEmpty()) {
+            qreal opacity = painter->opacity();
+            painter->setOpacity(opacity * color_.alphaF());
+            paint(painter, liveTiles_, range);
+            painter->setOpacity(opacity);
+        }
+    }
+    if (tail_.size() > 1) {
+        QColor color = color_;
+        color.setAlpha(255);
+        qreal opacity = painter->opacity();
+        painter->setOpacity(opacity * color_.alphaF());
+        painter->setRenderHint(QPainter::Antialiasing);
+        painter->setPen(QPen(color, lastWidth_, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        painter->drawPolyline(tail_);
+        painter->setOpacity(opacity);
+    }
+}
+
+QRectF InkSurface::drawSegment(const QPointF &from, const QPointF &to, qreal width)
+{
+    qreal margin = width / 2 + 1;
+    QRectF rect = QRectF(from, to).normalized().adjusted(-margin, -margin, margin, margin);
+    QRect range = tileRange(rect);
+    // live layer is opaque, pen alpha is applied when compositing
+    QColor color = color_;
+    color.setAlpha(255);
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            QImage & image = tile(liveTiles_, x, y);
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.scale(scale_, scale_);
+            painter.translate(-x * tileSize_, -y * tileSize_);
+            if (from == to) {
+                painter.setPen(Qt::NoPen);
+                painter.setBrush(color);
+                painter.drawEllipse(from, width / 2, width / 2);
+            } else {
+                painter.setPen(QPen(color, width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+                painter.drawLine(from, to);
+            }
+        }
+    }
+    liveBounds_ |= rect;
+    return rect;
+}
+
+QImage &InkSurface::tile(Tiles &tiles, int x, int y)
+{
+    QImage & image = tiles[tileKey(x, y)];
+    if (image.isNull()) {
+        int size = qCeil(tileSize_ * scale_);
+        image = QImage(size, size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+    }
+    return image;
+}
+
+QRect InkSurface::tileRange(const QRectF &rect) const
+{
+    if (rect.isEmpty())
+        return QRect();
+    return QRect(QPoint(qFloor(rect.left() / tileSize_), qFloor(rect.top() / tileSize_)),
+                 QPoint(qFloor(rect.right() / tileSize_), qFloor(rect.bottom() / tileSize_)));
+}
+
+void InkSurface::paint(QPainter *painter, const Tiles &tiles, const QRect &range) const
+{
+    // walk whichever is smaller, exposed tiles or allocated tiles
+    if (range.width() * range.height() <= tiles.size()) {
+        for (int y = range.top(); y <= range.bottom(); ++y) {
+            for (int x = range.left(); x <= range.right(); ++x) {
+                auto it = tiles.find(tileKey(x, y));
+                if (it != tiles.end())
+                    painter->drawImage(QRectF(x * tileSize_, y * tileSize_, tileSize_, tileSize_), it.value());
+            }
+        }
+    } else {
+        for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+            int x = tileX(it.key());
+            int y = tileY(it.key());
+            if (range.contains(x, y))
+                painter->drawImage(QRectF(x * tileSize_, y * tileSize_, tileSize_, tileSize_), it.value());
+        }
+    }
+}
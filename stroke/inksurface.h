@@ -0,0 +1,108 @@
+#ifndef INKSURFACE_H
+#define INKSURFACE_H
+
+#include "ShowBoard_global.h"
+
+#include <QHash>
+#include <QImage>
+#include <QColor>
+#include <QPolygonF>
+
+class QPainter;
+
+/*
+ * Two layer ink surface, backend of InkItem (graphics and quick)
+ *  finished layer: strokes composited once into lazily allocated tiles
+ *  live layer: stroke in progress, each new segment is drawn only into the
+ *   tiles it covers, and composited with pen opacity when painting, so that
+ *   translucent strokes do not darken where segments overlap
+ *  tail: short vector polyline after live stroke (predicted points), replaced
+ *   as a whole, never rasterized
+ *
+ * Every edit returns the dirty rect, item repaints only that rect, paint cost
+ *  per point is bounded by segment size, not by ink on surface
+ * Coordinates are item coordinates, tiles have scale() pixels per unit, that
+ *  follows device pixel ratio and zoom of painter (see deviceScale())
+ */
+
+class SHOWBOARD_EXPORT InkSurface
+{
+public:
+    InkSurface(int tileSize = 256);
+
+    ~InkSurface();
+
+public:
+    // width is used for points without own width
+    void setPen(QColor const & color, qreal width);
+
+    QColor color() const { return color_; }
+
+    qreal width() const { return width_; }
+
+    // tile pixels per unit, in steps of 1/4 up to 4, existing tiles are
+    //  resampled; return rect to repaint
+    QRectF setScale(qreal scale);
+
+    qreal scale() const { return scale_; }
+
+    // device pixels per unit of painter, device pixel ratio and zoom
+    static qreal deviceScale(QPainter * painter);
+
+public:
+    QRectF startStroke(QPointF const & point, qreal width = 0);
+
+    QRectF addPoint(QPointF const & point, qreal width = 0);
+
+    QRectF addPoints(QPolygonF const & points);
+
+    // replace tail, points continue from last point
+    QRectF setTail(QPolygonF const & tail);
+
+    // composite live layer into finished layer
+    QRectF endStroke();
+
+    // drop live layer
+    QRectF cancelStroke();
+
+    QRectF clear();
+
+public:
+    bool isDrawing() const { return drawing_; }
+
+    QPointF lastPoint() const { return last_; }
+
+    // bounds of all ink, including live layer
+    QRectF bounds() const;
+
+    int tileCount() const { return tiles_.size() + liveTiles_.size(); }
+
+    void paint(QPainter * painter, QRectF const & exposed) const;
+
+private:
+    typedef QHash<quint32, QImage> Tiles;
+
+    QRectF drawSegment(QPointF const & from, QPointF const & to, qreal width);
+
+    QImage & tile(Tiles & tiles, int x, int y);
+
+    QRect tileRange(QRectF const & rect) const;
+
+    void paint(QPainter * painter, Tiles const & tiles, QRect const & range) const;
+
+private:
+    int tileSize_;
+    qreal scale_ = 1;
+    QColor color_ = Qt::black;
+    qreal width_ = 2;
+    Tiles tiles_;
+    Tiles liveTiles_;
+    QRectF bounds_;
+    QRectF liveBounds_;
+    bool drawing_ = false;
+    QPointF last_;
+    qreal lastWidth_ = 0;
+    QPolygonF tail_;
+};
+
+#endif // INKSURFACE_H
@@ -0,0 +1,487 @@
+#include "livestrokes.h"
+#include "strokedelta.h"
+#include "data/localhttpserver.h"
+
+#include <QWebSocket>
+#include <QTimer>
+#include <QMutex>
+#include <QMap>
+#include <QHash>
+#include <QDebug>
+
+#include <atomic>
+
+static constexpr char PREFIX[] = "/strokes/live/";
+static constexpr qint64 MAX_PENDING = 64 * 1024; // bytes not written to client
+static constexpr int MAX_HISTORY = 256 * 1024; // points kept for catching up
+static constexpr int MAX_BATCH = 4096; // points of one message
+
+enum MessageType
+{
+    KeyMessage = 1,
+    DeltaMessage = 2,
+    EndMessage = 3,
+};
+
+struct LiveStrokesWriter::Channel
+{
+    QMutex mutex;
+    bool hasMax = false;
+    bool closed = false;
+    StrokePoint max = StrokePoint::EndStorke;
+    int base = 0; // seq of points[0], older ones are dropped
+    int keySeq = 0; // seq of latest stroke start, lagging clients resync there
+    QVector<StrokePoint> points;
+};
+
+typedef LiveStrokesWriter::Channel Channel;
+
+static void encodePoints(QByteArray & out, int seq, StrokePoint const * points, int count)
+{
+    putVarint(out, static_cast<quint32>(seq));
+    putVarint(out, static_cast<quint32>(count));
+    if (count == 0)
+        return;
+    out.append(points[0].data(), sizeof(StrokePoint));
+    StrokeDelta delta;
+    delta.start(points[0]);
+    for (int i = 1; i < count; ++i)
+        delta.put(out, points[i]);
+}
+
+static bool decodePoints(uchar const * p, uchar const * end, int & seq, QVector<StrokePoint> & points)
+{
+    quint32 s, count;
+    if (!getVarint(p, end, s) || !getVarint(p, end, count))
+        return false;
+    seq = static_cast<int>(s);
+    points.clear();
+    if (count == 0)
+        return true;
+    if (end - p < static_cast<int>(sizeof(StrokePoint)))
+        return false;
+    StrokePoint point;
+    memcpy(point.data(), p, sizeof(point));
+    p += sizeof(point);
+    points.append(point);
+    StrokeDelta delta;
+    delta.start(point);
+    for (quint32 i = 1; i < count; ++i) {
+        if (!delta.get(p, end, point))
+            return false;
+        points.append(point);
+    }
+    return true;
+}
+
+/*
+ * Web socket program of live channels, lives on LocalHttpServer thread
+ *  writers publish into channels on their own thread, program sends new
+ *  points to clients once per frame interval
+ */
+class LiveStrokesProgram : public QObject, public LocalHttpServer::LocalWebSocketProgram
+{
+public:
+    // writers may be created on any thread
+    static LiveStrokesProgram * instance()
+    {
+        static LiveStrokesProgram * program = [] () {
+            LiveStrokesProgram * program = new LiveStrokesProgram;
+            program->moveToThread(LocalHttpServer::instance()->thread());
+            emit LocalHttpServer::instance()->addWebSocketProgram(PREFIX, program);
+            return program;
+        }();
+        return program;
+    }
+
+public:
+    void setInterval(int interval)
+    {
+        interval_ = interval;
+    }
+
+    void addChannel(QByteArray const & name, QSharedPointer<Channel> channel)
+    {
+        QMutexLocker l(&mutex_);
+        channels_[name] = channel;
+    }
+
+    void removeChannel(QByteArray const & name, QSharedPointer<Channel> channel)
+    {
+        QMutexLocker l(&mutex_);
+        if (channels_.value(name) == channel)
+            channels_.remove(name);
+    }
+
+    virtual void handle(QByteArray const & path, QWebSocket * socket) override
+    {
+        Client client;
+        client.socket = socket;
+        client.name = path.mid(static_cast<int>(strlen(PREFIX)));
+        clients_.append(client);
+        connect(socket, &QWebSocket::disconnected, this, [this, socket] () {
+            for (int i = 0; i < clients_.size(); ++i) {
+                if (clients_[i].socket == socket) {
+                    clients_.removeAt(i);
+                    break;
+                }
+            }
+            socket->deleteLater();
+        });
+        if (timer_ == nullptr) {
+            timer_ = new QTimer(this);
+            timer_->setTimerType(Qt::PreciseTimer);
+            connect(timer_, &QTimer::timeout, this, &LiveStrokesProgram::tick);
+        }
+        if (!timer_->isActive())
+            timer_->start(interval_);
+        tick(); // key message with points by now
+    }
+
+private:
+    struct Client
+    {
+        QWebSocket * socket = nullptr;
+        QByteArray name;
+        QSharedPointer<Channel> channel;
+        int sent = -1; // points sent, -1 before key message
+        bool lagging = false;
+        bool ended = false;
+    };
+
+    void tick()
+    {
+        if (timer_->interval() != interval_)
+            timer_->setInterval(interval_);
+        if (clients_.isEmpty()) {
+            timer_->stop();
+            return;
+        }
+        // clients at same position share one message
+        QHash<QPair<Channel*, qint64>, Batch> batches;
+        for (Client & c : clients_) {
+            if (c.ended)
+                continue;
+            if (!c.channel) {
+                QMutexLocker l(&mutex_);
+                c.channel = channels_.value(c.name);
+                if (!c.channel)
+                    continue; // wait for writer
+            }
+            if (c.socket->bytesToWrite() > MAX_PENDING) {
+                c.lagging = true;
+                continue;
+            }
+            // key message resyncs with head again, from oldest kept point for
+            //  new client, from latest stroke start for lagging one
+            bool key = c.sent < 0 || c.lagging;
+            int from = c.sent < 0 ? 0 : c.sent;
+            QPair<Channel*, qint64> k(c.channel.get(), from * 4LL
+                                      + (key ? 1 : 0) + (c.lagging ? 2 : 0));
+            auto iter = batches.find(k);
+            if (iter == batches.end()) {
+                Batch batch;
+                if (!makeBatch(*c.channel, key, c.lagging, from, batch))
+                    continue;
+                iter = batches.insert(k, batch);
+            }
+            Batch const & batch = iter.value();
+            if (!batch.message.isEmpty())
+                c.socket->sendBinaryMessage(batch.message);
+            if (batch.end) {
+                c.socket->sendBinaryMessage(QByteArray(1, static_cast<char>(EndMessage)));
+                c.ended = true;
+            }
+            c.sent = batch.sent;
+            c.lagging = false;
+        }
+    }
+
+    struct Batch
+    {
+        QByteArray message;
+        int sent = 0;
+        bool end = false;
+    };
+
+    // message of points after from, at most MAX_BATCH, rest goes with later
+    //  frames; return false if channel is not started
+    bool makeBatch(Channel & channel, bool key, bool skip, int from, Batch & batch)
+    {
+        QVector<StrokePoint> points;
+        StrokePoint max;
+        {
+            QMutexLocker l(&channel.mutex);
+            if (!channel.hasMax)
+                return false;
+            max = channel.max;
+            if (from < channel.base) {
+                key = true;
+                from = channel.base;
+            }
+            // strokes before latest one are lost, instead of resending them
+            int end = channel.base + channel.points.size();
+            if (skip && end - from > MAX_BATCH && channel.keySeq > from)
+                from = channel.keySeq;
+            points = channel.points.mid(from - channel.base, MAX_BATCH);
+            batch.end = channel.closed && from + points.size() == end;
+        }
+        if (key || !points.isEmpty()) {
+            batch.message.append(static_cast<char>(key ? KeyMessage : DeltaMessage));
+            if (key)
+                batch.message.append(max.data(), sizeof(max));
+            encodePoints(batch.message, from, points.constData(), points.size());
+        }
+        batch.sent = from + points.size();
+        return true;
+    }
+
+private:
+    QMutex mutex_;
+    QMap<QByteArray, QSharedPointer<Channel>> channels_;
+    QList<Client> clients_;
+    QTimer * timer_ = nullptr;
+    std::atomic<int> interval_{16};
+};
+
+/* LiveStrokesWriter */
+
+QUrl LiveStrokesWriter::url(const QByteArray &name)
+{
+    QUrl url;
+    url.setScheme("ws");
+    url.setHost("127.0.0.1");
+    url.setPort(LocalHttpServer::instance()->port());
+    url.setPath(PREFIX + QString::fromUtf8(name));
+    return url;
+}
+
+void LiveStrokesWriter::setInterval(int interval)
+{
+    LiveStrokesProgram::instance()->setInterval(interval);
+}
+
+LiveStrokesWriter::LiveStrokesWriter(const QByteArray &name, StrokesWriter *writer, QObject *parent)
+    : StrokesWriter(writer ? writer->stream() : nullptr, parent)
+    , name_(name)
+    , writer_(writer)
+    , channel_(new Channel)
+{
+    if (writer_)
+        writer_->setParent(this);
+    LiveStrokesProgram::instance()->addChannel(name_, channel_);
+}
+
+LiveStrokesWriter::~LiveStrokesWriter()
+{
+    close();
+    LiveStrokesProgram::instance()->removeChannel(name_, channel_);
+}
+
+bool LiveStrokesWriter::setMaximun(StrokePoint &max)
+{
+    {
+        QMutexLocker l(&channel_->mutex);
+        channel_->max = max;
+        channel_->hasMax = true;
+        // seq goes on, connected readers keep counting from it
+        channel_->base += channel_->points.size();
+        channel_->keySeq = channel_->base;
+        channel_->points.clear();
+    }
+    return writer_ ? writer_->setMaximun(max) : true;
+}
+
+bool LiveStrokesWriter::write(StrokePoint &point)
+{
+    {
+        QMutexLocker l(&channel_->mutex);
+        QVector<StrokePoint> & points = channel_->points;
+        if (!point.s && (points.isEmpty() || points.last().s))
+            channel_->keySeq = channel_->base + points.size();
+        points.append(point);
+        if (points.size() > MAX_HISTORY) {
+            // drop older half, at a stroke start if there is one
+            int n = points.size() / 2;
+            int i = n;
+            while (i < points.size() && !points[i - 1].s)
+                ++i;
+            if (i < points.size())
+                n = i;
+            points.remove(0, n);
+            channel_->base += n;
+        }
+    }
+    return writer_ ? writer_->write(point) : true;
+}
+
+bool LiveStrokesWriter::flush()
+{
+    return writer_ ? writer_->flush() : true;
+}
+
+void LiveStrokesWriter::close()
+{
+    {
+        QMutexLocker l(&channel_->mutex);
+        channel_->closed = true;
+    }
+    if (writer_)
+        writer_->close();
+}
+
+/* LiveStrokesReader */
+
+LiveStrokesReader::LiveStrokesReader(const QUrl &url, QObject *parent)
+    : StrokesReader(nullptr, parent)
+    , socket_(new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this))
+    , max_(StrokePoint::EndStorke)
+{
+    connect(socket_, &QWebSocket::binaryMessageReceived, this, &LiveStrokesReader::onMessage);
+    connect(socket_, &QWebSocket::disconnected, this, &LiveStrokesReader::onClosed);
+    socket_->open(url);
+}
+
+LiveStrokesReader::~LiveStrokesReader()
+{
+}
+
+bool LiveStrokesReader::getMaximun(StrokePoint &max)
+{
+    if (!ready_)
+        return false;
+    max = max_;
+    pos_ = 0;
+    return true;
+}
+
+// byte position as raw stream, head takes first record
+bool LiveStrokesReader::seek(int bytePos)
+{
+    int pos = bytePos / static_cast<int>(sizeof(StrokePoint)) - 1 - first_;
+    if (pos < 0 || pos > points_.size())
+        return false;
+    pos_ = pos;
+    return true;
+}
+
+int LiveStrokesReader::bytePos()
+{
+    return (first_ + pos_ + 1) * static_cast<int>(sizeof(StrokePoint));
+}
+
+bool LiveStrokesReader::read(StrokePoint &point, int &bytePos)
+{
+    if (pos_ >= points_.size())
+        return false;
+    point = points_[pos_++];
+    bytePos = this->bytePos();
+    return true;
+}
+
+int LiveStrokesReader::readBatch(StrokePoint *points, int *bytePoses, int count)
+{
+    int n = qMin(count, points_.size() - pos_);
+    for (int i = 0; i < n; ++i) {
+        points[i] = points_[pos_++];
+        if (bytePoses)
+            bytePoses[i] = bytePos();
+    }
+    return n;
+}
+
+bool LiveStrokesReader::startAsyncRead(AsyncHandler handler)
+{
+    if (finished_ && pos_ >= points_.size())
+        return false;
+    handler_ = handler;
+    StrokePoint point;
+    int pos = 0;
+    while (handler_ && read(point, pos))
+        handler_(point, pos);
+    return true;
+}
+
+void LiveStrokesReader::stopAsyncRead()
+{
+    handler_ = nullptr;
+}
+
+void LiveStrokesReader::close()
+{
+    socket_->close();
+}
+
+void LiveStrokesReader::onMessage(const QByteArray &message)
+{
+    uchar const * p = reinterpret_cast<uchar const *>(message.constData());
+    uchar const * end = p + message.size();
+    if (p == end)
+        return;
+    uchar type = *p++;
+    if (type == EndMessage) {
+        onClosed();
+        return;
+    }
+    if (type == KeyMessage) {
+        if (end - p < static_cast<int>(sizeof(StrokePoint)))
+            return;
+        if (!ready_)
+            memcpy(max_.data(), p, sizeof(max_));
+        p += sizeof(StrokePoint);
+    } else if (type != DeltaMessage || !ready_) {
+        return;
+    }
+    int seq = 0;
+    QVector<StrokePoint> points;
+    if (!decodePoints(p, end, seq, points)) {
+        qWarning() << "LiveStrokesReader bad message";
+        return;
+    }
+    if (seq > next_) {
+        if (type != KeyMessage) {
+            qWarning() << "LiveStrokesReader lost points" << next_ << seq;
+            return;
+        }
+        // writer dropped points not sent to us, strokes in them are lost
+        if (!points_.isEmpty() && !points_.last().s) {
+            StrokePoint point = points_.last();
+            point.s = 1;
+            point.p = 0;
+            points_.append(point);
+        }
+        next_ = seq;
+    }
+    // key message after lagging overlaps received points
+    int skip = next_ - seq;
+    if (skip < points.size()) {
+        points_.append(points.mid(skip));
+        next_ = seq + points.size();
+    }
+    if (points_.size() > MAX_HISTORY) {
+        // drop older half of read points, they can't be seeked to any more
+        int n = qMin(points_.size() / 2, pos_);
+        points_.remove(0, n);
+        first_ += n;
+        pos_ -= n;
+    }
+    if (!ready_) {
+        ready_ = true;
+        emit ready();
+    }
+    StrokePoint point;
+    int pos = 0;
+    while (handler_ && read(point, pos))
+        handler_(point, pos);
+}
+
+void LiveStrokesReader::onClosed()
+{
+    if (finished_)
+        return;
+    finished_ = true;
+    if (handler_) {
+        handler_ = nullptr;
+        emit asyncFinished();
+    }
+}
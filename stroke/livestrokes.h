@@ -0,0 +1,116 @@
+#ifndef LIVESTROKES_H
+#define LIVESTROKES_H
+
+#include "strokesreader.h"
+#include "strokeswriter.h"
+
+#include <QUrl>
+#include <QVector>
+#include <QSharedPointer>
+
+class QWebSocket;
+
+/*
+ * Live stroke streaming over LocalHttpServer web socket
+ *  path: /strokes/live/<name>
+ *
+ * Binary messages, points of one message are delta encoded as spz blocks
+ *  (first point absolute, then StrokeDelta coded)
+ *  key:   u8 1, maximun point, varint seq of first point, varint count, points
+ *  delta: u8 2, varint seq of first point, varint count, points
+ *  end:   u8 3
+ *
+ * Points are batched per frame interval, at most 4096 points per message,
+ *  more go with next frames. A client that has too many bytes not written
+ *  is skipped, and resyncs with a key message from the latest stroke start
+ *  when drained, missing strokes before it; key message is also the first
+ *  one sent to a client (from oldest kept point).
+ * Only recent points are kept (older half is dropped at a stroke start), a
+ *  client behind them resyncs from oldest kept point and misses the rest.
+ *  Seq of points goes on over setMaximun(). The reader also keeps only
+ *  recent points, and can't seek to dropped ones.
+ */
+
+class SHOWBOARD_EXPORT LiveStrokesWriter : public StrokesWriter
+{
+    Q_OBJECT
+public:
+    struct Channel;
+
+    // url to connect LiveStrokesReader with on local host
+    static QUrl url(QByteArray const & name);
+
+    // frame interval (ms) of all channels
+    static void setInterval(int interval);
+
+public:
+    // publish as name, points are also written to writer if not null (take ownership)
+    LiveStrokesWriter(QByteArray const & name, StrokesWriter * writer = nullptr, QObject *parent = nullptr);
+
+    virtual ~LiveStrokesWriter() override;
+
+public:
+    virtual bool setMaximun(StrokePoint & max) override;
+
+    virtual bool write(StrokePoint & point) override;
+
+    virtual bool flush() override;
+
+    virtual void close() override;
+
+private:
+    QByteArray name_;
+    StrokesWriter * writer_;
+    QSharedPointer<Channel> channel_;
+};
+
+class SHOWBOARD_EXPORT LiveStrokesReader : public StrokesReader
+{
+    Q_OBJECT
+public:
+    LiveStrokesReader(QUrl const & url, QObject *parent = nullptr);
+
+    virtual ~LiveStrokesReader() override;
+
+signals:
+    // maximun point is received, renderer can start now
+    void ready();
+
+public:
+    bool isReady() const { return ready_; }
+
+public:
+    virtual bool getMaximun(StrokePoint & max) override;
+
+    virtual bool seek(int bytePos) override;
+
+    virtual int bytePos() override;
+
+    virtual bool read(StrokePoint & point, int & bytePos) override;
+
+    virtual int readBatch(StrokePoint * points, int * bytePoses, int count) override;
+
+    virtual bool startAsyncRead(AsyncHandler handler) override;
+
+    virtual void stopAsyncRead() override;
+
+    virtual void close() override;
+
+private:
+    void onMessage(QByteArray const & message);
+
+    void onClosed();
+
+private:
+    QWebSocket * socket_;
+    bool ready_ = false;
+    bool finished_ = false;
+    StrokePoint max_;
+    QVector<StrokePoint> points_; // recent received
+    int first_ = 0; // received points dropped before points_
+    int pos_ = 0; // index of next point
+    int next_ = 0; // seq of next point from writer
+    AsyncHandler handler_;
+};
+
+#endif // LIVESTROKES_H
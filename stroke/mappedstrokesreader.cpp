@@ -0,0 +1,223 @@
+#include "mappedstrokesreader.h"
+
+#include <qexport.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <climits>
+
+REGISTER_STROKE_READER(MappedStrokesReader, "spts")
+
+static constexpr int INDEX_STRIDE = 1024; // points
+static constexpr quint32 INDEX_MAGIC = 0x53504958; // SPIX
+static constexpr quint32 INDEX_VERSION = 1;
+
+MappedStrokesReader::MappedStrokesReader(QIODevice * stream, QObject *parent)
+    : StrokesReader(stream, parent)
+{
+    QFile * file = qobject_cast<QFile*>(stream);
+    if (file && file->isOpen() && file->size() < INT_MAX) {
+        size_ = static_cast<int>(file->size());
+        data_ = file->map(0, size_);
+        if (data_ == nullptr) {
+            qWarning() << "MappedStrokesReader map failed" << file->errorString();
+            size_ = 0;
+        }
+    }
+}
+
+bool MappedStrokesReader::getMaximun(StrokePoint &max)
+{
+    if (data_ == nullptr)
+        return StrokesReader::getMaximun(max);
+    int pos = 0;
+    pos_ = 0;
+    return read(max, pos);
+}
+
+bool MappedStrokesReader::seek(int bytePos)
+{
+    if (data_ == nullptr)
+        return StrokesReader::seek(bytePos);
+    if (bytePos < 0 || bytePos > size_)
+        return false;
+    pos_ = bytePos;
+    return true;
+}
+
+int MappedStrokesReader::bytePos()
+{
+    if (data_ == nullptr)
+        return StrokesReader::bytePos();
+    return pos_;
+}
+
+bool MappedStrokesReader::read(StrokePoint &point, int &bytePos)
+{
+    if (data_ == nullptr) {
+        // leave partial point in stream, until rest of it arrives
+        if (stream_->bytesAvailable() < static_cast<qint64>(sizeof(point)))
+            return false;
+        if (stream_->read(point.data(), sizeof(point)) != sizeof(point))
+            return false;
+        bytePos = static_cast<int>(stream_->pos());
+        return true;
+    }
+    if (pos_ + static_cast<int>(sizeof(point)) > size_)
+        return false;
+    memcpy(point.data(), data_ + pos_, sizeof(point));
+    pos_ += sizeof(point);
+    bytePos = pos_;
+    return true;
+}
+
+int MappedStrokesReader::readBatch(StrokePoint *points, int *bytePoses, int count)
+{
+    if (data_ == nullptr)
+        return StrokesReader::readBatch(points, bytePoses, count);
+    int n = qMin(count, (size_ - pos_) / static_cast<int>(sizeof(StrokePoint)));
+    if (n <= 0)
+        return 0;
+    memcpy(points, data_ + pos_, static_cast<size_t>(n) * sizeof(StrokePoint));
+    if (bytePoses) {
+        for (int i = 0; i < n; ++i)
+            bytePoses[i] = pos_ + (i + 1) * static_cast<int>(sizeof(StrokePoint));
+    }
+    pos_ += n * static_cast<int>(sizeof(StrokePoint));
+    return n;
+}
+
+bool MappedStrokesReader::findIndex(int time, IndexPoint &index)
+{
+    if (data_ == nullptr)
+        return false;
+    if (!indexed_) {
+        QFile * file = static_cast<QFile*>(stream_);
+        if (!loadIndex(file->fileName() + ".idx")) {
+            buildIndex();
+            saveIndex(file->fileName() + ".idx");
+        }
+        indexed_ = true;
+    }
+    if (index_.isEmpty())
+        return false;
+    auto iter = std::upper_bound(index_.begin(), index_.end(), time,
+                                 [] (int t, IndexPoint const & i) {
+        return t < i.time;
+    });
+    if (iter != index_.begin())
+        --iter;
+    index = *iter;
+    return true;
+}
+
+bool MappedStrokesReader::startAsyncRead(AsyncHandler handler)
+{
+    // all data is available, nothing to wait
+    if (data_)
+        return false;
+    return StrokesReader::startAsyncRead(handler);
+}
+
+void MappedStrokesReader::close()
+{
+    if (data_) {
+        static_cast<QFile*>(stream_)->unmap(const_cast<uchar*>(data_));
+        data_ = nullptr;
+        size_ = 0;
+    }
+    StrokesReader::close();
+}
+
+/*
+ * Simulate StrokesRenderer::bump() & addPoint2() to record renderer state
+ *  every INDEX_STRIDE points
+ */
+void MappedStrokesReader::buildIndex()
+{
+    index_.clear();
+    if (size_ < static_cast<int>(sizeof(StrokePoint)))
+        return;
+    StrokePoint const * points = reinterpret_cast<StrokePoint const *>(data_);
+    int count = size_ / static_cast<int>(sizeof(StrokePoint));
+    bool hasTime = points[0].t != 0;
+    IndexPoint state;
+    IndexPoint stroke;
+    index_.reserve(count / INDEX_STRIDE + 1);
+    for (int i = 1; i < count; ++i) {
+        StrokePoint const & point = points[i];
+        state.bytePos = i * static_cast<int>(sizeof(StrokePoint));
+        if (!point.s && !state.inStroke) {
+            stroke = state;
+        }
+        if ((i - 1) % INDEX_STRIDE == 0) {
+            IndexPoint index = state;
+            if (state.inStroke) {
+                index.strokeByte = stroke.bytePos;
+                index.strokeTime = stroke.time;
+                index.strokeT = stroke.t;
+            } else {
+                index.strokeByte = state.bytePos;
+                index.strokeTime = state.time;
+                index.strokeT = state.t;
+            }
+            index_.append(index);
+        }
+        if (hasTime) {
+            if (state.time > 0) {
+                state.time += (point.t - state.t) & 0xffff;
+            } else if (state.t != 0) {
+                state.time = (point.t - state.t) & 0xffff;
+            }
+        } else {
+            state.time += 10;
+        }
+        state.t = point.t;
+        state.inStroke = !point.s;
+    }
+}
+
+bool MappedStrokesReader::loadIndex(const QString &file)
+{
+    QFile f(file);
+    if (!f.open(QFile::ReadOnly))
+        return false;
+    QFileInfo info(static_cast<QFile*>(stream_)->fileName());
+    QDataStream ds(&f);
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 size = 0, mtime = 0;
+    ds >> magic >> version >> size >> mtime >> count;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION
+            || size != info.size() || mtime != info.lastModified().toMSecsSinceEpoch())
+        return false;
+    index_.resize(static_cast<int>(count));
+    for (IndexPoint & i : index_) {
+        ds >> i.bytePos >> i.time >> i.t >> i.inStroke
+                >> i.strokeByte >> i.strokeTime >> i.strokeT;
+    }
+    if (ds.status() != QDataStream::Ok) {
+        index_.clear();
+        return false;
+    }
+    return true;
+}
+
+void MappedStrokesReader::saveIndex(const QString &file)
+{
+    QFile f(file);
+    if (!f.open(QFile::WriteOnly)) // maybe read only location
+        return;
+    QFileInfo info(static_cast<QFile*>(stream_)->fileName());
+    QDataStream ds(&f);
+    ds << INDEX_MAGIC << INDEX_VERSION << info.size()
+       << info.lastModified().toMSecsSinceEpoch() << static_cast<quint32>(index_.size());
+    for (IndexPoint const & i : index_) {
+        ds << i.bytePos << i.time << i.t << i.inStroke
+           << i.strokeByte << i.strokeTime << i.strokeT;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef MAPPEDSTROKESREADER_H
+#define MAPPEDSTROKESREADER_H
+
+#include "strokesreader.h"
+
+#include <QVector>
+
+/*
+ * Reader of raw StrokePoint streams (one maximun point as head, then points).
+ *  If stream is a local file, it is memory mapped and a sparse time index is
+ *  built (or loaded from sidecar file "<file>.idx"), so seeking to any time
+ *  is a binary search plus a short forward scan.
+ *  Other streams are read sequentially, without index.
+ */
+
+class SHOWBOARD_EXPORT MappedStrokesReader : public StrokesReader
+{
+    Q_OBJECT
+public:
+    Q_INVOKABLE MappedStrokesReader(QIODevice * stream, QObject *parent = nullptr);
+
+public:
+    bool isMapped() const { return data_ != nullptr; }
+
+public:
+    virtual bool getMaximun(StrokePoint & max) override;
+
+    virtual bool seek(int bytePos) override;
+
+    virtual int bytePos() override;
+
+    virtual bool read(StrokePoint & point, int & bytePos) override;
+
+    virtual int readBatch(StrokePoint * points, int * bytePoses, int count) override;
+
+    virtual bool findIndex(int time, IndexPoint & index) override;
+
+    virtual bool startAsyncRead(AsyncHandler handler) override;
+
+    virtual void close() override;
+
+private:
+    void buildIndex();
+
+    bool loadIndex(QString const & file);
+
+    void saveIndex(QString const & file);
+
+private:
+    uchar const * data_ = nullptr;
+    int size_ = 0;
+    int pos_ = 0;
+    bool indexed_ = false;
+    QVector<IndexPoint> index_;
+};
+
+#endif // MAPPEDSTROKESREADER_H
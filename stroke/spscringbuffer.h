@@ -0,0 +1,72 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <QVector>
+
+#include <atomic>
+
+/*
+ * Bounded lock free ring buffer, for one producer thread and one consumer thread
+ */
+
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    // capacity is rounded up to power of 2
+    explicit SpscRingBuffer(int capacity)
+    {
+        int n = 1;
+        while (n < capacity)
+            n <<= 1;
+        buffer_.resize(n);
+        mask_ = static_cast<size_t>(n - 1);
+    }
+
+public:
+    int capacity() const { return buffer_.size(); }
+
+    int size() const
+    {
+        return static_cast<int>(head_.load(std::memory_order_acquire)
+                                - tail_.load(std::memory_order_acquire));
+    }
+
+    bool isEmpty() const { return size() == 0; }
+
+    bool isFull() const { return size() == capacity(); }
+
+public:
+    // producer
+    bool push(T const & t)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_)
+            return false;
+        buffer_[static_cast<int>(head & mask_)] = t;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, return number of items popped
+    int pop(T * t, int count)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t n = head_.load(std::memory_order_acquire) - tail;
+        if (n > static_cast<size_t>(count))
+            n = static_cast<size_t>(count);
+        for (size_t i = 0; i < n; ++i)
+            t[i] = buffer_[static_cast<int>((tail + i) & mask_)];
+        tail_.store(tail + n, std::memory_order_release);
+        return static_cast<int>(n);
+    }
+
+private:
+    Q_DISABLE_COPY(SpscRingBuffer)
+    QVector<T> buffer_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif // SPSCRINGBUFFER_H
@@ -1,11 +1,44 @@
 HEADERS += \
+    $$PWD/bufferedstrokeswriter.h \
+    $$PWD/compactstrokes.h \
+    $$PWD/imagestrokesrenderer.h \
+    $$PWD/inkpredictor.h \
+    $$PWD/inksurface.h \
+    $$PWD/livestrokes.h \
+    $$PWD/mappedstrokesreader.h \
+    $$PWD/spscringbuffer.h \
+    $$PWD/strokedecoder.h \
+    $$PWD/strokedelta.h \
     $$PWD/strokepoint.h \
+    $$PWD/strokescheckpoints.h \
+    $$PWD/strokesclock.h \
+    $$PWD/strokesimplifier.h \
+    $$PWD/strokesindex.h \
+    $$PWD/strokesmetadata.h \
+    $$PWD/strokesmixer.h \
     $$PWD/strokesreader.h \
     $$PWD/strokesrenderer.h \
-    $$PWD/strokeswriter.h
+    $$PWD/strokeswriter.h \
+    $$PWD/threadedstrokesdecoder.h \
+    $$PWD/varint.h
 
 SOURCES += \
+    $$PWD/bufferedstrokeswriter.cpp \
+    $$PWD/compactstrokes.cpp \
+    $$PWD/imagestrokesrenderer.cpp \
+    $$PWD/inkpredictor.cpp \
+    $$PWD/inksurface.cpp \
+    $$PWD/livestrokes.cpp \
+    $$PWD/mappedstrokesreader.cpp \
+    $$PWD/strokedecoder.cpp \
     $$PWD/strokepoint.cpp \
+    $$PWD/strokescheckpoints.cpp \
+    $$PWD/strokesclock.cpp \
+    $$PWD/strokesimplifier.cpp \
+    $$PWD/strokesindex.cpp \
+    $$PWD/strokesmetadata.cpp \
+    $$PWD/strokesmixer.cpp \
     $$PWD/strokesreader.cpp \
     $$PWD/strokesrenderer.cpp \
-    $$PWD/strokeswriter.cpp
+    $$PWD/strokeswriter.cpp \
+    $$PWD/threadedstrokesdecoder.cpp
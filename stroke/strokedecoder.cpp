@@ -0,0 +1,294 @@
+#include "strokedecoder.h"
+
+#if defined(Q_PROCESSOR_X86_64) || (defined(Q_PROCESSOR_X86) && defined(__SSE2__))
+#  define STROKE_DECODER_X86 1
+#  include <immintrin.h>
+#  ifdef Q_CC_MSVC
+#    include <intrin.h>
+#    define TARGET_AVX2
+#  else
+#    define TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
+QRect StrokeDecoder::Block::bounds() const
+{
+    if (isEmpty())
+        return QRect();
+    return QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+}
+
+StrokeDecoder::StrokeDecoder(bool hasTime, Kernel kernel)
+    : hasTime_(hasTime)
+    , kernel_(kernel == Auto ? bestKernel() : kernel)
+{
+#ifndef STROKE_DECODER_X86
+    kernel_ = Scalar;
+#endif
+}
+
+void StrokeDecoder::reset(int time, ushort t)
+{
+    time_ = time;
+    t_ = t;
+}
+
+struct DecodeState
+{
+    int time;
+    ushort t;
+    bool hasTime;
+};
+
+static void decodeScalar(StrokePoint const * points, int count,
+                         DecodeState & st, StrokeDecoder::Block & b, int offset)
+{
+    for (int i = 0; i < count; ++i) {
+        StrokePoint const & point = points[i];
+        if (st.hasTime) {
+            if (st.time > 0) {
+                st.time += (point.t - st.t) & 0xffff;
+            } else if (st.t != 0) {
+                st.time = (point.t - st.t) & 0xffff;
+            }
+        } else {
+            st.time += 10;
+        }
+        st.t = point.t;
+        int j = offset + i;
+        b.time[j] = st.time;
+        b.x[j] = point.x;
+        b.y[j] = point.y;
+        b.pressure[j] = point.p;
+        b.state[j] = point.s;
+        if (!point.s) {
+            if (point.x < b.minX) b.minX = point.x;
+            if (point.x > b.maxX) b.maxX = point.x;
+            if (point.y < b.minY) b.minY = point.y;
+            if (point.y > b.maxY) b.maxY = point.y;
+        }
+    }
+}
+
+#ifdef STROKE_DECODER_X86
+
+static void reduceBounds(short const * mins, short const * maxs, int n,
+                         ushort & minV, ushort & maxV)
+{
+    for (int i = 0; i < n; ++i) {
+        ushort mi = static_cast<ushort>(mins[i] ^ 0x8000);
+        ushort ma = static_cast<ushort>(maxs[i] ^ 0x8000);
+        if (mi < minV) minV = mi;
+        if (ma > maxV) maxV = ma;
+    }
+}
+
+// 8 points per loop, return points decoded
+static int decodeSSE2(StrokePoint const * points, int count,
+                      DecodeState & st, StrokeDecoder::Block & b, int offset)
+{
+    int n = count & ~7;
+    if (n == 0)
+        return 0;
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(static_cast<short>(0x8000));
+    __m128i const pmask = _mm_set1_epi16(0x7fff);
+    __m128i const ten = _mm_set1_epi16(10);
+    __m128i minX = _mm_set1_epi16(0x7fff), minY = minX;
+    __m128i maxX = bias, maxY = bias;
+    __m128i base = _mm_set1_epi32(st.time);
+    ushort lastT = st.t;
+    for (int i = 0; i < n; i += 8) {
+        __m128i const * src = reinterpret_cast<__m128i const *>(points + i);
+        __m128i a = _mm_loadu_si128(src);
+        __m128i c = _mm_loadu_si128(src + 1);
+        __m128i d = _mm_loadu_si128(src + 2);
+        __m128i e = _mm_loadu_si128(src + 3);
+        // transpose t p x y of 8 points
+        __m128i ac0 = _mm_unpacklo_epi16(a, c), ac1 = _mm_unpackhi_epi16(a, c);
+        __m128i de0 = _mm_unpacklo_epi16(d, e), de1 = _mm_unpackhi_epi16(d, e);
+        __m128i tp0 = _mm_unpacklo_epi16(ac0, ac1), xy0 = _mm_unpackhi_epi16(ac0, ac1);
+        __m128i tp1 = _mm_unpacklo_epi16(de0, de1), xy1 = _mm_unpackhi_epi16(de0, de1);
+        __m128i T = _mm_unpacklo_epi64(tp0, tp1);
+        __m128i P = _mm_unpackhi_epi64(tp0, tp1);
+        __m128i X = _mm_unpacklo_epi64(xy0, xy1);
+        __m128i Y = _mm_unpackhi_epi64(xy0, xy1);
+        int j = offset + i;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b.x.data() + j), X);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b.y.data() + j), Y);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b.pressure.data() + j), _mm_and_si128(P, pmask));
+        __m128i S = _mm_srli_epi16(P, 15);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(b.state.data() + j), _mm_packus_epi16(S, zero));
+        // bounds, exclude state points
+        __m128i mask = _mm_srai_epi16(P, 15);
+        minX = _mm_min_epi16(minX, _mm_xor_si128(_mm_or_si128(X, mask), bias));
+        minY = _mm_min_epi16(minY, _mm_xor_si128(_mm_or_si128(Y, mask), bias));
+        maxX = _mm_max_epi16(maxX, _mm_xor_si128(_mm_andnot_si128(mask, X), bias));
+        maxY = _mm_max_epi16(maxY, _mm_xor_si128(_mm_andnot_si128(mask, Y), bias));
+        // time: prefix sum of 16 bits deltas
+        __m128i D = ten;
+        if (st.hasTime) {
+            __m128i Tp = _mm_or_si128(_mm_slli_si128(T, 2), _mm_cvtsi32_si128(lastT));
+            D = _mm_sub_epi16(T, Tp);
+        }
+        __m128i lo = _mm_unpacklo_epi16(D, zero);
+        __m128i hi = _mm_unpackhi_epi16(D, zero);
+        lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 4));
+        lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 8));
+        lo = _mm_add_epi32(lo, base);
+        base = _mm_shuffle_epi32(lo, 0xff);
+        hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 4));
+        hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 8));
+        hi = _mm_add_epi32(hi, base);
+        base = _mm_shuffle_epi32(hi, 0xff);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b.time.data() + j), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(b.time.data() + j + 4), hi);
+        lastT = points[i + 7].t;
+    }
+    st.time = _mm_cvtsi128_si32(base);
+    st.t = lastT;
+    short mins[8], maxs[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(mins), minX);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(maxs), maxX);
+    reduceBounds(mins, maxs, 8, b.minX, b.maxX);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(mins), minY);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(maxs), maxY);
+    reduceBounds(mins, maxs, 8, b.minY, b.maxY);
+    return n;
+}
+
+// 16 points per loop, return points decoded
+TARGET_AVX2
+static int decodeAVX2(StrokePoint const * points, int count,
+                      DecodeState & st, StrokeDecoder::Block & b, int offset)
+{
+    int n = count & ~15;
+    if (n == 0)
+        return 0;
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const bias = _mm256_set1_epi16(static_cast<short>(0x8000));
+    __m256i const pmask = _mm256_set1_epi16(0x7fff);
+    __m256i const ten = _mm256_set1_epi16(10);
+    __m256i const last = _mm256_set1_epi32(7);
+    __m256i minX = _mm256_set1_epi16(0x7fff), minY = minX;
+    __m256i maxX = bias, maxY = bias;
+    __m256i base = _mm256_set1_epi32(st.time);
+    ushort lastT = st.t;
+    for (int i = 0; i < n; i += 16) {
+        __m256i const * src = reinterpret_cast<__m256i const *>(points + i);
+        __m256i a0 = _mm256_loadu_si256(src);
+        __m256i c0 = _mm256_loadu_si256(src + 1);
+        __m256i d0 = _mm256_loadu_si256(src + 2);
+        __m256i e0 = _mm256_loadu_si256(src + 3);
+        // lane 0 take points 0-3 (8-11), lane 1 take points 4-7 (12-15)
+        __m256i a = _mm256_permute2x128_si256(a0, c0, 0x20);
+        __m256i c = _mm256_permute2x128_si256(a0, c0, 0x31);
+        __m256i d = _mm256_permute2x128_si256(d0, e0, 0x20);
+        __m256i e = _mm256_permute2x128_si256(d0, e0, 0x31);
+        __m256i ac0 = _mm256_unpacklo_epi16(a, c), ac1 = _mm256_unpackhi_epi16(a, c);
+        __m256i de0 = _mm256_unpacklo_epi16(d, e), de1 = _mm256_unpackhi_epi16(d, e);
+        __m256i tp0 = _mm256_unpacklo_epi16(ac0, ac1), xy0 = _mm256_unpackhi_epi16(ac0, ac1);
+        __m256i tp1 = _mm256_unpacklo_epi16(de0, de1), xy1 = _mm256_unpackhi_epi16(de0, de1);
+        // qwords are in order 0-3, 8-11, 4-7, 12-15
+        __m256i T = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(tp0, tp1), 0xd8);
+        __m256i P = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(tp0, tp1), 0xd8);
+        __m256i X = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(xy0, xy1), 0xd8);
+        __m256i Y = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(xy0, xy1), 0xd8);
+        int j = offset + i;
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(b.x.data() + j), X);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(b.y.data() + j), Y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(b.pressure.data() + j), _mm256_and_si256(P, pmask));
+        __m256i S = _mm256_packus_epi16(_mm256_srli_epi16(P, 15), zero);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(b.state.data() + j), _mm256_castsi256_si128(S));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(b.state.data() + j + 8), _mm256_extracti128_si256(S, 1));
+        __m256i mask = _mm256_srai_epi16(P, 15);
+        minX = _mm256_min_epi16(minX, _mm256_xor_si256(_mm256_or_si256(X, mask), bias));
+        minY = _mm256_min_epi16(minY, _mm256_xor_si256(_mm256_or_si256(Y, mask), bias));
+        maxX = _mm256_max_epi16(maxX, _mm256_xor_si256(_mm256_andnot_si256(mask, X), bias));
+        maxY = _mm256_max_epi16(maxY, _mm256_xor_si256(_mm256_andnot_si256(mask, Y), bias));
+        __m256i D = ten;
+        if (st.hasTime) {
+            // shift left one word across lanes
+            __m256i Tp = _mm256_alignr_epi8(T, _mm256_permute2x128_si256(T, T, 0x08), 14);
+            Tp = _mm256_or_si256(Tp, _mm256_castsi128_si256(_mm_cvtsi32_si128(lastT)));
+            D = _mm256_sub_epi16(T, Tp);
+        }
+        __m256i halves[2] = {
+            _mm256_cvtepu16_epi32(_mm256_castsi256_si128(D)),
+            _mm256_cvtepu16_epi32(_mm256_extracti128_si256(D, 1))
+        };
+        for (int k = 0; k < 2; ++k) {
+            __m256i s = halves[k];
+            s = _mm256_add_epi32(s, _mm256_slli_si256(s, 4));
+            s = _mm256_add_epi32(s, _mm256_slli_si256(s, 8));
+            s = _mm256_add_epi32(s, _mm256_shuffle_epi32(_mm256_permute2x128_si256(s, s, 0x08), 0xff));
+            s = _mm256_add_epi32(s, base);
+            base = _mm256_permutevar8x32_epi32(s, last);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(b.time.data() + j + k * 8), s);
+        }
+        lastT = points[i + 15].t;
+    }
+    st.time = _mm_cvtsi128_si32(_mm256_castsi256_si128(base));
+    st.t = lastT;
+    short mins[16], maxs[16];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(mins), minX);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxs), maxX);
+    reduceBounds(mins, maxs, 16, b.minX, b.maxX);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(mins), minY);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxs), maxY);
+    reduceBounds(mins, maxs, 16, b.minY, b.maxY);
+    return n;
+}
+
+#endif // STROKE_DECODER_X86
+
+int StrokeDecoder::decode(StrokePoint const * points, int count, Block & block)
+{
+    block.count = count;
+    block.time.resize(count);
+    block.x.resize(count);
+    block.y.resize(count);
+    block.pressure.resize(count);
+    block.state.resize(count);
+    block.minX = block.minY = 0xffff;
+    block.maxX = block.maxY = 0;
+    DecodeState st {time_, t_, hasTime_};
+    int i = 0;
+    // leading points before time is started, see StrokesRenderer::bump()
+    while (hasTime_ && st.time == 0 && i < count) {
+        decodeScalar(points + i, 1, st, block, i);
+        ++i;
+    }
+#ifdef STROKE_DECODER_X86
+    if (kernel_ == AVX2)
+        i += decodeAVX2(points + i, count - i, st, block, i);
+    if (kernel_ != Scalar)
+        i += decodeSSE2(points + i, count - i, st, block, i);
+#endif
+    decodeScalar(points + i, count - i, st, block, i);
+    time_ = st.time;
+    t_ = st.t;
+    return count;
+}
+
+StrokeDecoder::Kernel StrokeDecoder::bestKernel()
+{
+#ifdef STROKE_DECODER_X86
+    static Kernel best = [] () {
+#  ifdef Q_CC_MSVC
+        int regs[4];
+        __cpuid(regs, 1);
+        bool avx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28))
+                && (_xgetbv(0) & 6) == 6;
+        __cpuidex(regs, 7, 0);
+        return avx && (regs[1] & (1 << 5)) ? AVX2 : SSE2;
+#  else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#  endif
+    }();
+    return best;
+#else
+    return Scalar;
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef STROKEDECODER_H
+#define STROKEDECODER_H
+
+#include "ShowBoard_global.h"
+
+#include "strokepoint.h"
+
+#include <QRect>
+#include <QVector>
+
+/*
+ * Bulk decoder of raw StrokePoint records into SoA arrays
+ *  time is unwrapped the same way as StrokesRenderer::bump()
+ *  bounds only include stroke points (state 0)
+ */
+
+class SHOWBOARD_EXPORT StrokeDecoder
+{
+public:
+    enum Kernel
+    {
+        Auto,
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    struct Block
+    {
+        int count = 0;
+        QVector<int> time; // in point time
+        QVector<ushort> x;
+        QVector<ushort> y;
+        QVector<ushort> pressure;
+        QVector<uchar> state;
+        ushort minX = 0xffff;
+        ushort minY = 0xffff;
+        ushort maxX = 0;
+        ushort maxY = 0;
+
+        bool isEmpty() const { return minX > maxX; }
+        QRect bounds() const;
+    };
+
+    // hasTime: maximun point has time unit, else every point takes 10
+    StrokeDecoder(bool hasTime = true, Kernel kernel = Auto);
+
+public:
+    Kernel kernel() const { return kernel_; }
+
+    int time() const { return time_; }
+
+    ushort lastT() const { return t_; }
+
+    // state of previous point, see StrokesRenderer::seek()
+    void reset(int time = 0, ushort t = 0);
+
+    // decode into block (resized to count), return count
+    int decode(StrokePoint const * points, int count, Block & block);
+
+public:
+    static Kernel bestKernel();
+
+private:
+    bool hasTime_;
+    Kernel kernel_;
+    int time_ = 0;
+    ushort t_ = 0;
+};
+
+#endif // STROKEDECODER_H
@@ -0,0 +1,99 @@
+#ifndef STROKEDELTA_H
+#define STROKEDELTA_H
+
+#include "strokepoint.h"
+#include "varint.h"
+
+/*
+ * Delta coding of stroke points, shared by spz blocks and live messages
+ *  tag byte: s, dt changed, dp not 0, more xy, low 4 bits of xy
+ *  then [varint xy >> 4], [varint dt], [zigzag varint dp]
+ *  xy: bit interleaved zigzag of dx, dy minus last dx, dy (0 at start of
+ *   run and of stroke), so steady motion costs 1 byte, most points 1 to 3
+ *
+ * start() with absolute point of a run (block, message), then put() or get()
+ *  following points in order
+ */
+
+class StrokeDelta
+{
+public:
+    void start(StrokePoint const & point)
+    {
+        last_ = point;
+        dt_ = dx_ = dy_ = 0;
+    }
+
+    void put(QByteArray & out, StrokePoint const & point)
+    {
+        int dt = static_cast<ushort>(point.t - last_.t);
+        int dx = static_cast<short>(point.x - last_.x);
+        int dy = static_cast<short>(point.y - last_.y);
+        int dp = point.p - last_.p;
+        if (last_.s)
+            dx_ = dy_ = 0;
+        // residual against last motion is near 0 on smooth strokes
+        quint32 xy = interleave(zigzag(static_cast<short>(dx - dx_)) & 0xffff,
+                                zigzag(static_cast<short>(dy - dy_)) & 0xffff);
+        uchar tag = static_cast<uchar>((xy & 0xf) << 4 | point.s);
+        if (xy >> 4)
+            tag |= More;
+        if (dt != dt_)
+            tag |= Time;
+        if (dp)
+            tag |= Pressure;
+        out.append(static_cast<char>(tag));
+        if (tag & More)
+            putVarint(out, xy >> 4);
+        if (tag & Time)
+            putVarint(out, static_cast<quint32>(dt));
+        if (tag & Pressure)
+            putVarint(out, zigzag(dp));
+        last_ = point;
+        dt_ = dt;
+        dx_ = dx;
+        dy_ = dy;
+    }
+
+    bool get(uchar const *& p, uchar const * end, StrokePoint & point)
+    {
+        if (p == end)
+            return false;
+        uchar tag = *p++;
+        quint32 more = 0, dt = static_cast<quint32>(dt_), dp = 0;
+        if (((tag & More) && !getVarint(p, end, more))
+                || ((tag & Time) && !getVarint(p, end, dt))
+                || ((tag & Pressure) && !getVarint(p, end, dp)))
+            return false;
+        if (last_.s)
+            dx_ = dy_ = 0;
+        quint32 rx, ry;
+        deinterleave(more << 4 | tag >> 4, rx, ry);
+        dt_ = static_cast<int>(dt);
+        dx_ = static_cast<short>(dx_ + unzigzag(rx));
+        dy_ = static_cast<short>(dy_ + unzigzag(ry));
+        point.t = static_cast<ushort>(last_.t + dt_);
+        point.x = static_cast<ushort>(last_.x + dx_);
+        point.y = static_cast<ushort>(last_.y + dy_);
+        point.p = static_cast<ushort>(last_.p + unzigzag(dp)) & 0x7fff;
+        point.s = tag & State;
+        last_ = point;
+        return true;
+    }
+
+private:
+    enum Tag : uchar
+    {
+        State = 1,
+        Time = 2, // dt differs from last dt, varint follows
+        Pressure = 4, // dp is not 0, zigzag varint follows
+        More = 8, // rest of xy residual, varint follows
+    };
+
+    StrokePoint last_ = StrokePoint::EndStorke;
+    int dt_ = 0;
+    int dx_ = 0;
+    int dy_ = 0;
+};
+
+#endif // STROKEDELTA_H
@@ -0,0 +1,57 @@
+#include "strokescheckpoints.h"
+
+#include <QDebug>
+
+StrokesCheckpoints::StrokesCheckpoints(int interval, qint64 budget)
+    : interval_(interval)
+    , budget_(budget)
+    , nextTime_(interval)
+{
+}
+
+void StrokesCheckpoints::add(Checkpoint const & checkpoint)
+{
+    // may be added again after seek backward
+    int i = 0;
+    for (; i < checkpoints_.size(); ++i) {
+        if (checkpoints_[i].time >= checkpoint.time)
+            break;
+    }
+    if (i < checkpoints_.size() && checkpoints_[i].time - checkpoint.time < interval_ / 2) {
+        nextTime_ = checkpoint.time + interval_;
+        return;
+    }
+    checkpoints_.insert(i, checkpoint);
+    memory_ += checkpoint.image.sizeInBytes();
+    nextTime_ = checkpoint.time + interval_;
+    while (memory_ > budget_ && checkpoints_.size() > 1)
+        thin();
+}
+
+StrokesCheckpoints::Checkpoint const * StrokesCheckpoints::find(int time) const
+{
+    Checkpoint const * c = nullptr;
+    for (Checkpoint const & cp : checkpoints_) {
+        if (cp.time > time)
+            break;
+        c = &cp;
+    }
+    return c;
+}
+
+void StrokesCheckpoints::clear()
+{
+    checkpoints_.clear();
+    memory_ = 0;
+    nextTime_ = interval_;
+}
+
+void StrokesCheckpoints::thin()
+{
+    for (int i = checkpoints_.size() - 1; i > 0; i -= 2) {
+        memory_ -= checkpoints_[i].image.sizeInBytes();
+        checkpoints_.removeAt(i);
+    }
+    interval_ *= 2;
+    qDebug() << "StrokesCheckpoints thin" << checkpoints_.size() << interval_ << memory_;
+}
@@ -0,0 +1,63 @@
+#ifndef STROKESCHECKPOINTS_H
+#define STROKESCHECKPOINTS_H
+
+#include "ShowBoard_global.h"
+
+#include "strokepoint.h"
+
+#include <QImage>
+#include <QList>
+
+/*
+ * Raster keyframes of StrokesRenderer, with reader position and stroke state
+ *  When over memory budget, every other keyframe is dropped and interval
+ *  is doubled, so keyframes keep covering whole playback evenly.
+ */
+
+class SHOWBOARD_EXPORT StrokesCheckpoints
+{
+public:
+    struct Checkpoint
+    {
+        int time = 0; // in ms
+        int pointTime = 0; // in point time
+        int byte = 0; // reader position after point
+        StrokePoint point; // last point
+        bool inStroke = false;
+        int strokeTime = 0;
+        int strokeByte = 0;
+        QImage image;
+    };
+
+    StrokesCheckpoints(int interval, qint64 budget);
+
+public:
+    int interval() const { return interval_; }
+
+    qint64 budget() const { return budget_; }
+
+    qint64 memory() const { return memory_; }
+
+    int count() const { return checkpoints_.size(); }
+
+    bool due(int time) const { return time >= nextTime_; }
+
+    void add(Checkpoint const & checkpoint);
+
+    // last checkpoint not after time
+    Checkpoint const * find(int time) const;
+
+    void clear();
+
+private:
+    void thin();
+
+private:
+    int interval_;
+    qint64 budget_;
+    qint64 memory_ = 0;
+    int nextTime_ = 0;
+    QList<Checkpoint> checkpoints_;
+};
+
+#endif // STROKESCHECKPOINTS_H
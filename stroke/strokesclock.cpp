@@ -0,0 +1,178 @@
+#include "strokesclock.h"
+#include "strokesrenderer.h"
+
+#include <QAbstractAnimation>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QTimer>
+
+#include <climits>
+
+class StrokesClockAnimation : public QAbstractAnimation
+{
+public:
+    StrokesClockAnimation(StrokesClock * clock)
+        : QAbstractAnimation(clock)
+        , clock_(clock)
+    {
+    }
+
+    virtual int duration() const override { return -1; }
+
+protected:
+    virtual void updateCurrentTime(int) override
+    {
+        clock_->tick();
+    }
+
+private:
+    StrokesClock * clock_;
+};
+
+StrokesClock *StrokesClock::instance()
+{
+    // not a static object, that goes after app and its timers
+    static StrokesClock * clock = [] () {
+        StrokesClock * clock = new StrokesClock;
+        if (QCoreApplication::instance()) {
+            // its timers run on GUI thread, whoever asks first
+            clock->moveToThread(QCoreApplication::instance()->thread());
+            QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                             clock, &StrokesClock::shutdown);
+        }
+        return clock;
+    }();
+    return clock;
+}
+
+StrokesClock::StrokesClock(QObject *parent)
+    : QObject(parent)
+    , timer_(new QTimer(this))
+    , animation_(new StrokesClockAnimation(this))
+{
+    elapsed_.start();
+    timer_->setSingleShot(true);
+    timer_->setTimerType(Qt::PreciseTimer);
+    connect(timer_, &QTimer::timeout, this, &StrokesClock::tick);
+}
+
+StrokesClock::~StrokesClock()
+{
+}
+
+void StrokesClock::setMode(Mode mode)
+{
+    if (mode == mode_)
+        return;
+    if (mode == VirtualMode)
+        virtualTime_ = now();
+    mode_ = mode;
+    if (timer_ == nullptr)
+        return;
+    timer_->stop();
+    animation_->stop();
+    restart();
+}
+
+int StrokesClock::now() const
+{
+    if (mode_ == VirtualMode)
+        return virtualTime_;
+    return static_cast<int>(elapsed_.elapsed());
+}
+
+void StrokesClock::schedule(StrokesRenderer *renderer, int delay)
+{
+    wakes_[renderer] = now() + (delay < 0 ? 0 : delay);
+    restart();
+}
+
+void StrokesClock::cancel(StrokesRenderer *renderer)
+{
+    if (wakes_.remove(renderer) && wakes_.isEmpty())
+        restart();
+}
+
+int StrokesClock::advance(int time)
+{
+    if (mode_ != VirtualMode)
+        return 0;
+    int target = virtualTime_ + time;
+    int n = 0;
+    while (true) {
+        n += pass();
+        int next = INT_MAX;
+        for (int due : wakes_)
+            next = qMin(next, due);
+        if (next > target)
+            break;
+        if (next > virtualTime_)
+            virtualTime_ = next;
+    }
+    virtualTime_ = target;
+    return n;
+}
+
+int StrokesClock::pass()
+{
+    int t = now();
+    QList<QPointer<StrokesRenderer>> dues;
+    for (auto iter = wakes_.begin(); iter != wakes_.end();) {
+        if (iter.value() <= t) {
+            dues.append(iter.key());
+            iter = wakes_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    // renderer may be deleted by others in this pass
+    for (QPointer<StrokesRenderer> & r : dues) {
+        if (r)
+            r->bump();
+    }
+    if (!dues.isEmpty())
+        emit ticked();
+    return dues.size();
+}
+
+void StrokesClock::tick()
+{
+    pass();
+    restart();
+}
+
+void StrokesClock::restart()
+{
+    if (timer_ == nullptr) // shut down
+        return;
+    if (wakes_.isEmpty()) {
+        timer_->stop();
+        animation_->stop();
+        return;
+    }
+    if (mode_ == VirtualMode)
+        return;
+    int next = INT_MAX;
+    for (int due : wakes_)
+        next = qMin(next, due);
+    int delay = next - now();
+    if (delay <= 0) {
+        // fast mode, not wait for next frame
+        if (!timer_->isActive() || timer_->remainingTime() > 0)
+            timer_->start(0);
+    } else if (mode_ == TimerMode) {
+        if (!timer_->isActive() || timer_->remainingTime() > delay)
+            timer_->start(delay);
+    }
+    if (mode_ == FrameMode && animation_->state() != QAbstractAnimation::Running)
+        animation_->start();
+}
+
+void StrokesClock::shutdown()
+{
+    wakes_.clear();
+    delete timer_;
+    timer_ = nullptr;
+    delete animation_;
+    animation_ = nullptr;
+}
@@ -0,0 +1,86 @@
+#ifndef STROKESCLOCK_H
+#define STROKESCLOCK_H
+
+#include "ShowBoard_global.h"
+
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+
+class StrokesRenderer;
+class QTimer;
+class QAbstractAnimation;
+
+/*
+ * Playback clock shared by StrokesRenderer instances
+ *  one tick source wakes all due renderers in one pass
+ *  TimerMode: single precise timer, sleep until next due renderer
+ *  FrameMode: driven by animation timer (QUnifiedTimer, about 16ms, not vsync)
+ *  VirtualMode: time only moves with advance(), deterministic and fast
+ *
+ * Shared instance stops ticking at QCoreApplication::aboutToQuit, before
+ *  app is destroyed; it still accepts calls from renderers left
+ */
+
+class SHOWBOARD_EXPORT StrokesClock : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode
+    {
+        TimerMode,
+        FrameMode,
+        VirtualMode,
+    };
+
+    Q_ENUM(Mode)
+
+    static StrokesClock * instance();
+
+public:
+    explicit StrokesClock(QObject *parent = nullptr);
+
+    virtual ~StrokesClock() override;
+
+public:
+    Mode mode() const { return mode_; }
+
+    void setMode(Mode mode);
+
+    // in ms
+    int now() const;
+
+    int count() const { return wakes_.size(); }
+
+    // wake renderer after delay, 0 for next pass as soon as possible
+    void schedule(StrokesRenderer * renderer, int delay);
+
+    void cancel(StrokesRenderer * renderer);
+
+    // only for virtual mode, return number of renderer wakes
+    int advance(int time);
+
+signals:
+    void ticked();
+
+private:
+    friend class StrokesClockAnimation;
+
+    int pass();
+
+    void tick();
+
+    void restart();
+
+    void shutdown();
+
+private:
+    Mode mode_ = TimerMode;
+    QElapsedTimer elapsed_;
+    int virtualTime_ = 0;
+    QHash<StrokesRenderer*, int> wakes_; // due time
+    QTimer * timer_;
+    QAbstractAnimation * animation_;
+};
+
+#endif // STROKESCLOCK_H
@@ -0,0 +1,136 @@
+#include "strokesimplifier.h"
+#include "core/resourcetransform.h"
+
+/* StrokeSimplifier */
+
+StrokeSimplifier::StrokeSimplifier(qreal tolerance)
+    : last_(StrokePoint::EndStorke)
+    , held_(StrokePoint::EndStorke)
+{
+    setTolerance(tolerance);
+}
+
+qreal StrokeSimplifier::toleranceFor(qreal pixels, qreal unitScale, qreal zoom)
+{
+    qreal scale = unitScale * zoom;
+    return scale > 0 ? pixels / scale : 0;
+}
+
+qreal StrokeSimplifier::toleranceFor(qreal pixels, qreal unitScale, const ResourceTransform &transform)
+{
+    return toleranceFor(pixels, unitScale, transform.zoom());
+}
+
+void StrokeSimplifier::setTolerance(qreal tolerance)
+{
+    tolerance_ = tolerance;
+    tolerance2_ = tolerance * tolerance;
+}
+
+void StrokeSimplifier::start(const StrokePoint &point)
+{
+    last_ = point;
+    hasHeld_ = false;
+}
+
+int StrokeSimplifier::filter(const StrokePoint *points, int count, StrokePoint *out)
+{
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        StrokePoint const & p = points[i];
+        qreal dx = p.x - last_.x;
+        qreal dy = p.y - last_.y;
+        if (dx * dx + dy * dy <= tolerance2_) {
+            held_ = p;
+            hasHeld_ = true;
+            continue;
+        }
+        out[n++] = p;
+        last_ = p;
+        hasHeld_ = false;
+    }
+    return n;
+}
+
+bool StrokeSimplifier::finish(StrokePoint &point)
+{
+    if (!hasHeld_)
+        return false;
+    point = held_;
+    hasHeld_ = false;
+    return true;
+}
+
+/* StrokeLod */
+
+StrokeLod::StrokeLod(const QVector<StrokePoint> &points)
+{
+    levels_.append(points);
+    for (int l = 1; l < MAX_LEVELS && levels_.last().size() > 2; ++l) {
+        QVector<StrokePoint> level = simplify(levels_.first(), levelTolerance(l));
+        if (level.size() == levels_.last().size())
+            level = levels_.last(); // shared, level index keeps tolerance
+        levels_.append(level);
+    }
+}
+
+qreal StrokeLod::levelTolerance(int level)
+{
+    return level == 0 ? 0 : (1 << (level - 1));
+}
+
+int StrokeLod::levelFor(qreal tolerance) const
+{
+    int level = 0;
+    while (level + 1 < levels_.size() && levelTolerance(level + 1) <= tolerance)
+        ++level;
+    return level;
+}
+
+static qreal distance2(QPointF const & p, QPointF const & a, QPointF const & b)
+{
+    QPointF ab = b - a;
+    QPointF ap = p - a;
+    qreal len2 = QPointF::dotProduct(ab, ab);
+    if (len2 > 0) {
+        qreal t = qBound(0.0, QPointF::dotProduct(ap, ab) / len2, 1.0);
+        ap -= ab * t;
+    }
+    return QPointF::dotProduct(ap, ap);
+}
+
+QVector<StrokePoint> StrokeLod::simplify(const QVector<StrokePoint> &points, qreal tolerance)
+{
+    if (points.size() <= 2)
+        return points;
+    QVector<bool> keep(points.size(), false);
+    keep.first() = keep.last() = true;
+    qreal tolerance2 = tolerance * tolerance;
+    QVector<QPair<int, int>> stack;
+    stack.append({0, points.size() - 1});
+    while (!stack.isEmpty()) {
+        QPair<int, int> r = stack.takeLast();
+        QPointF a = points[r.first];
+        QPointF b = points[r.second];
+        qreal max = 0;
+        int index = -1;
+        for (int i = r.first + 1; i < r.second; ++i) {
+            qreal d = distance2(points[i], a, b);
+            if (d > max) {
+                max = d;
+                index = i;
+            }
+        }
+        if (index >= 0 && max > tolerance2) {
+            keep[index] = true;
+            stack.append({r.first, index});
+            stack.append({index, r.second});
+        }
+    }
+    QVector<StrokePoint> result;
+    for (int i = 0; i < points.size(); ++i) {
+        if (keep[i])
+            result.append(points[i]);
+    }
+    return result;
+}
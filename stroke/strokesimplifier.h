@@ -0,0 +1,87 @@
+#ifndef STROKESIMPLIFIER_H
+#define STROKESIMPLIFIER_H
+
+#include "ShowBoard_global.h"
+
+#include "strokepoint.h"
+
+#include <QVector>
+
+class ResourceTransform;
+
+/*
+ * Online radial distance filter of stroke points
+ *  points within tolerance (stroke units) of last kept point are dropped,
+ *  last dropped point is held back and kept when stroke ends, so strokes
+ *  always keep their first and last point
+ */
+
+class SHOWBOARD_EXPORT StrokeSimplifier
+{
+public:
+    StrokeSimplifier(qreal tolerance = 0);
+
+public:
+    // tolerance in stroke units for pixels on device
+    //  unitScale: device pixels of one stroke unit when zoom is 1
+    static qreal toleranceFor(qreal pixels, qreal unitScale, qreal zoom);
+
+    static qreal toleranceFor(qreal pixels, qreal unitScale, ResourceTransform const & transform);
+
+public:
+    qreal tolerance() const { return tolerance_; }
+
+    void setTolerance(qreal tolerance);
+
+    // start of stroke, always kept
+    void start(StrokePoint const & point);
+
+    // filter points of stroke into out (may be same as points), return count kept
+    int filter(StrokePoint const * points, int count, StrokePoint * out);
+
+    // end of stroke, return true if a held back point should be added
+    bool finish(StrokePoint & point);
+
+private:
+    qreal tolerance_;
+    qreal tolerance2_; // squared
+    StrokePoint last_;
+    StrokePoint held_;
+    bool hasHeld_ = false;
+};
+
+/*
+ * Level of detail pyramid of a finished stroke
+ *  level 0 is original points, level n is simplified by Ramer-Douglas-Peucker
+ *  with tolerance (1 << (n - 1)) stroke units, until 2 points are left
+ *  pick level with tolerance from toleranceFor() at current zoom
+ */
+
+class SHOWBOARD_EXPORT StrokeLod
+{
+public:
+    static constexpr int MAX_LEVELS = 8;
+
+    StrokeLod() {}
+
+    StrokeLod(QVector<StrokePoint> const & points);
+
+public:
+    int levelCount() const { return levels_.size(); }
+
+    // tolerance of level in stroke units
+    static qreal levelTolerance(int level);
+
+    // coarsest level with tolerance not above tolerance
+    int levelFor(qreal tolerance) const;
+
+    QVector<StrokePoint> const & points(int level = 0) const { return levels_[level]; }
+
+public:
+    static QVector<StrokePoint> simplify(QVector<StrokePoint> const & points, qreal tolerance);
+
+private:
+    QVector<QVector<StrokePoint>> levels_;
+};
+
+#endif // STROKESIMPLIFIER_H
@@ -0,0 +1,400 @@
+#include "strokesindex.h"
+
+#include <QLineF>
+#include <QtMath>
+
+static qreal distance2(QPointF const & p, QPointF const & a, QPointF const & b)
+{
+    QPointF ab = b - a;
+    QPointF ap = p - a;
+    qreal len2 = QPointF::dotProduct(ab, ab);
+    if (len2 > 0) {
+        qreal t = qBound(0.0, QPointF::dotProduct(ap, ab) / len2, 1.0);
+        ap -= ab * t;
+    }
+    return QPointF::dotProduct(ap, ap);
+}
+
+static qreal distance2(QPointF const & a1, QPointF const & b1, QPointF const & a2, QPointF const & b2)
+{
+    if (QLineF(a1, b1).intersect(QLineF(a2, b2), nullptr) == QLineF::BoundedIntersection)
+        return 0;
+    return qMin(qMin(distance2(a1, a2, b2), distance2(b1, a2, b2)),
+                qMin(distance2(a2, a1, b1), distance2(b2, a1, b1)));
+}
+
+// Liang-Barsky clipping
+static bool intersects(QPointF const & a, QPointF const & b, QRectF const & rect)
+{
+    qreal t0 = 0, t1 = 1;
+    qreal dx = b.x() - a.x(), dy = b.y() - a.y();
+    qreal p[] = {-dx, dx, -dy, dy};
+    qreal q[] = {a.x() - rect.left(), rect.right() - a.x(),
+                 a.y() - rect.top(), rect.bottom() - a.y()};
+    for (int i = 0; i < 4; ++i) {
+        if (qFuzzyIsNull(p[i])) {
+            if (q[i] < 0)
+                return false;
+            continue;
+        }
+        qreal t = q[i] / p[i];
+        if (p[i] < 0)
+            t0 = qMax(t0, t);
+        else
+            t1 = qMin(t1, t);
+        if (t0 > t1)
+            return false;
+    }
+    return true;
+}
+
+StrokesIndex::StrokesIndex(int cellSize)
+    : cellSize_(cellSize)
+{
+}
+
+int StrokesIndex::startStroke(const StrokePoint &point, int key)
+{
+    if (current_ >= 0)
+        endStroke();
+    if (key >= 0) {
+        auto iter = keys_.find(key);
+        if (iter != keys_.end())
+            removeStroke(iter.value());
+        keys_.insert(key, strokes_.size());
+    }
+    Stroke stroke;
+    stroke.key = key;
+    stroke.alive = true;
+    stroke.bounds = QRect(point, point);
+    stroke.points.append(point);
+    strokes_.append(stroke);
+    ++count_;
+    current_ = strokes_.size() - 1;
+    chunkFirst_ = 0;
+    return current_;
+}
+
+void StrokesIndex::addPoint(const StrokePoint &point)
+{
+    addPoints(&point, 1);
+}
+
+void StrokesIndex::addPoints(const StrokePoint *points, int count)
+{
+    if (current_ < 0)
+        return;
+    Stroke & stroke = strokes_[current_];
+    for (int i = 0; i < count; ++i) {
+        stroke.points.append(points[i]);
+        stroke.bounds |= QRect(points[i], points[i]);
+        if (stroke.points.size() - chunkFirst_ > CHUNK)
+            flushChunk(false);
+    }
+}
+
+void StrokesIndex::endStroke()
+{
+    if (current_ < 0)
+        return;
+    flushChunk(true);
+    Stroke & stroke = strokes_[current_];
+    stroke.points.squeeze();
+    stroke.lod = StrokeLod(stroke.points);
+    current_ = -1;
+}
+
+void StrokesIndex::removeStroke(int id)
+{
+    Stroke & stroke = strokes_[id];
+    if (!stroke.alive)
+        return;
+    for (int c : stroke.chunks) {
+        removeChunk(c);
+        freeChunks_.append(c);
+    }
+    if (stroke.key >= 0 && keys_.value(stroke.key, -1) == id)
+        keys_.remove(stroke.key);
+    stroke.alive = false;
+    stroke.points.clear();
+    stroke.points.squeeze();
+    stroke.chunks.clear();
+    stroke.lod = StrokeLod();
+    --count_;
+    if (current_ == id)
+        current_ = -1;
+}
+
+void StrokesIndex::truncate(int key)
+{
+    QVector<int> ids;
+    for (auto iter = keys_.cbegin(); iter != keys_.cend(); ++iter) {
+        if (iter.key() > key)
+            ids.append(iter.value());
+    }
+    for (int id : ids)
+        removeStroke(id);
+    // replays after seeks leave removed strokes behind
+    if (strokes_.size() - count_ > count_)
+        compact();
+}
+
+int StrokesIndex::findStroke(int key) const
+{
+    int id = -1;
+    int found = -1;
+    for (auto iter = keys_.cbegin(); iter != keys_.cend(); ++iter) {
+        if (iter.key() <= key && iter.key() > found) {
+            found = iter.key();
+            id = iter.value();
+        }
+    }
+    return id;
+}
+
+void StrokesIndex::compact()
+{
+    QVector<int> ids(strokes_.size(), -1);
+    int n = 0;
+    for (int i = 0; i < strokes_.size(); ++i) {
+        if (!strokes_[i].alive)
+            continue;
+        if (n != i)
+            strokes_[n] = strokes_[i];
+        for (int c : strokes_[n].chunks)
+            chunks_[c].stroke = n;
+        ids[i] = n++;
+    }
+    strokes_.resize(n);
+    for (auto iter = keys_.begin(); iter != keys_.end(); ++iter)
+        iter.value() = ids[iter.value()];
+    if (current_ >= 0)
+        current_ = ids[current_];
+    marks_.clear();
+}
+
+void StrokesIndex::clear()
+{
+    strokes_.clear();
+    chunks_.clear();
+    freeChunks_.clear();
+    keys_.clear();
+    cells_.clear();
+    count_ = 0;
+    current_ = -1;
+}
+
+bool StrokesIndex::contains(int id) const
+{
+    return id >= 0 && id < strokes_.size() && strokes_[id].alive;
+}
+
+const QVector<StrokePoint> &StrokesIndex::points(int id, qreal tolerance, qreal *levelTolerance) const
+{
+    Stroke const & stroke = strokes_[id];
+    int level = stroke.lod.levelCount() ? stroke.lod.levelFor(tolerance) : 0;
+    if (levelTolerance)
+        *levelTolerance = StrokeLod::levelTolerance(level);
+    return level ? stroke.lod.points(level) : stroke.points;
+}
+
+QVector<int> StrokesIndex::strokes() const
+{
+    QVector<int> ids;
+    ids.reserve(count_);
+    for (int i = 0; i < strokes_.size(); ++i) {
+        if (strokes_[i].alive)
+            ids.append(i);
+    }
+    return ids;
+}
+
+QVector<int> StrokesIndex::query(const QRect &rect) const
+{
+    QRectF r(rect);
+    return search(rect, false, [this, r] (Chunk const & c) {
+        StrokePoint const * p = strokes_[c.stroke].points.constData() + c.first;
+        if (c.count == 1)
+            return r.contains(p[0]);
+        for (int i = 1; i < c.count; ++i) {
+            if (intersects(p[i - 1], p[i], r))
+                return true;
+        }
+        return false;
+    });
+}
+
+QVector<int> StrokesIndex::query(const QPoint &center, qreal radius, qreal tolerance) const
+{
+    int r = qCeil(radius);
+    QRect rect(center - QPoint(r, r), center + QPoint(r, r));
+    auto test = [center] (StrokePoint const * p, int count, qreal r2) {
+        if (count == 1)
+            return distance2(center, p[0], p[0]) <= r2;
+        for (int i = 1; i < count; ++i) {
+            if (distance2(center, p[i - 1], p[i]) <= r2)
+                return true;
+        }
+        return false;
+    };
+    if (tolerance > 0) {
+        // whole stroke on its level, simplified line is off by level tolerance
+        return search(rect, true, [this, radius, tolerance, test] (Chunk const & c) {
+            qreal t = 0;
+            QVector<StrokePoint> const & p = points(c.stroke, tolerance, &t);
+            return test(p.constData(), p.size(), (radius + t) * (radius + t));
+        });
+    }
+    qreal r2 = radius * radius;
+    return search(rect, false, [this, r2, test] (Chunk const & c) {
+        return test(strokes_[c.stroke].points.constData() + c.first, c.count, r2);
+    });
+}
+
+QVector<int> StrokesIndex::query(const QPolygon &polyline, qreal radius, qreal tolerance) const
+{
+    if (polyline.size() == 1)
+        return query(polyline.first(), radius, tolerance);
+    int r = qCeil(radius);
+    QRect rect = polyline.boundingRect().adjusted(-r, -r, r, r);
+    auto test = [&polyline] (StrokePoint const * p, int count, QRect const & bounds, qreal r2) {
+        for (int j = 1; j < polyline.size(); ++j) {
+            QPointF a = polyline[j - 1];
+            QPointF b = polyline[j];
+            if (!bounds.intersects(QRect(polyline[j - 1], polyline[j]).normalized()))
+                continue;
+            if (count == 1 && distance2(p[0], a, b) <= r2)
+                return true;
+            for (int i = 1; i < count; ++i) {
+                if (distance2(p[i - 1], p[i], a, b) <= r2)
+                    return true;
+            }
+        }
+        return false;
+    };
+    if (tolerance > 0) {
+        return search(rect, true, [this, radius, tolerance, test] (Chunk const & c) {
+            qreal t = 0;
+            QVector<StrokePoint> const & p = points(c.stroke, tolerance, &t);
+            int r = qCeil(radius + t);
+            QRect bounds = strokes_[c.stroke].bounds.adjusted(-r, -r, r, r);
+            return test(p.constData(), p.size(), bounds, (radius + t) * (radius + t));
+        });
+    }
+    qreal r2 = radius * radius;
+    return search(rect, false, [this, r, r2, test] (Chunk const & c) {
+        QRect bounds = c.bounds.adjusted(-r, -r, r, r);
+        return test(strokes_[c.stroke].points.constData() + c.first, c.count, bounds, r2);
+    });
+}
+
+QVector<int> StrokesIndex::lasso(const QPolygon &polygon) const
+{
+    QRect rect = polygon.boundingRect();
+    return search(rect, true, [this, &polygon, rect] (Chunk const & c) {
+        Stroke const & stroke = strokes_[c.stroke];
+        if (!rect.contains(stroke.bounds))
+            return false;
+        for (StrokePoint const & p : stroke.points) {
+            if (!polygon.containsPoint(p, Qt::OddEvenFill))
+                return false;
+        }
+        return true;
+    });
+}
+
+void StrokesIndex::flushChunk(bool final)
+{
+    Stroke & stroke = strokes_[current_];
+    int count = stroke.points.size() - chunkFirst_;
+    // last point of previous chunk is shared
+    if (count < 2 && !(final && chunkFirst_ == 0))
+        return;
+    Chunk chunk;
+    chunk.stroke = current_;
+    chunk.first = chunkFirst_;
+    chunk.count = count;
+    StrokePoint const * p = stroke.points.constData() + chunkFirst_;
+    ushort x1 = p[0].x, y1 = p[0].y, x2 = p[0].x, y2 = p[0].y;
+    for (int i = 1; i < count; ++i) {
+        x1 = qMin(x1, p[i].x); y1 = qMin(y1, p[i].y);
+        x2 = qMax(x2, p[i].x); y2 = qMax(y2, p[i].y);
+    }
+    chunk.bounds = QRect(QPoint(x1, y1), QPoint(x2, y2));
+    int id;
+    if (freeChunks_.isEmpty()) {
+        id = chunks_.size();
+        chunks_.append(chunk);
+    } else {
+        id = freeChunks_.takeLast();
+        chunks_[id] = chunk;
+    }
+    insertChunk(id);
+    stroke.chunks.append(id);
+    chunkFirst_ = stroke.points.size() - 1;
+}
+
+void StrokesIndex::insertChunk(int chunk)
+{
+    visitCells(chunks_[chunk].bounds, [this, chunk] (quint32 key) {
+        cells_[key].append(chunk);
+    });
+}
+
+void StrokesIndex::removeChunk(int chunk)
+{
+    visitCells(chunks_[chunk].bounds, [this, chunk] (quint32 key) {
+        auto iter = cells_.find(key);
+        if (iter == cells_.end())
+            return;
+        iter->removeOne(chunk);
+        if (iter->isEmpty())
+            cells_.erase(iter);
+    });
+}
+
+template<typename Test>
+QVector<int> StrokesIndex::search(const QRect &rect, bool perStroke, Test test) const
+{
+    QVector<int> result;
+    if (++mark_ == 0) { // wrap, reset marks
+        marks_.fill(0);
+        chunkMarks_.fill(0);
+        mark_ = 1;
+    }
+    marks_.resize(strokes_.size());
+    chunkMarks_.resize(chunks_.size());
+    visitCells(rect, [&] (quint32 key) {
+        auto iter = cells_.find(key);
+        if (iter == cells_.end())
+            return;
+        for (int c : iter.value()) {
+            Chunk const & chunk = chunks_[c];
+            if (chunkMarks_[c] == mark_ || marks_[chunk.stroke] == mark_)
+                continue;
+            chunkMarks_[c] = mark_;
+            if (!chunk.bounds.intersects(rect))
+                continue;
+            if (perStroke)
+                marks_[chunk.stroke] = mark_;
+            if (test(chunk)) {
+                marks_[chunk.stroke] = mark_;
+                result.append(chunk.stroke);
+            }
+        }
+    });
+    return result;
+}
+
+template<typename Visit>
+void StrokesIndex::visitCells(const QRect &rect, Visit visit) const
+{
+    int x1 = qMax(rect.left(), 0) / cellSize_;
+    int y1 = qMax(rect.top(), 0) / cellSize_;
+    int x2 = qMin(rect.right(), 0xffff) / cellSize_;
+    int y2 = qMin(rect.bottom(), 0xffff) / cellSize_;
+    for (int y = y1; y <= y2; ++y) {
+        for (int x = x1; x <= x2; ++x)
+            visit(static_cast<quint32>(y) << 16 | static_cast<quint32>(x));
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef STROKESINDEX_H
+#define STROKESINDEX_H
+
+#include "ShowBoard_global.h"
+
+#include "strokepoint.h"
+#include "strokesimplifier.h"
+
+#include <QVector>
+#include <QHash>
+#include <QRect>
+#include <QPolygon>
+
+/*
+ * Uniform grid index of stroke chunks for hit testing, erasing and lasso
+ *  strokes are split into chunks of CHUNK segments, bounding box of each
+ *  chunk is put into grid cells it covers; points are kept for exact tests
+ *  coordinates are stroke units, as points are
+ *
+ * Built incrementally with startStroke/addPoint/endStroke, stroke key (start
+ *  byte position) makes replay after seek replace the same stroke, strokes
+ *  after a backward seek are truncated; points of stroke in progress are
+ *  searchable when a chunk is full or stroke ends
+ * Stroke ids are not kept by truncate(), it compacts removed strokes
+ *
+ * Finished strokes keep a StrokeLod, tolerance (stroke units, from
+ *  StrokeSimplifier::toleranceFor() at current zoom) picks coarsest level
+ *  for drawing and for brush and eraser hit tests
+ */
+
+class SHOWBOARD_EXPORT StrokesIndex
+{
+public:
+    static constexpr int CHUNK = 32;
+
+    StrokesIndex(int cellSize = 256);
+
+public:
+    // return id of stroke, replace stroke with same key if any
+    int startStroke(StrokePoint const & point, int key = -1);
+
+    void addPoint(StrokePoint const & point);
+
+    void addPoints(StrokePoint const * points, int count);
+
+    void endStroke();
+
+    void removeStroke(int id);
+
+    // remove strokes with key after key, when replay goes back to it; stroke
+    //  with key is in progress there, caller may start it again
+    void truncate(int key);
+
+    void clear();
+
+public:
+    int strokeCount() const { return count_; }
+
+    bool contains(int id) const;
+
+    QRect bounds(int id) const { return strokes_[id].bounds; }
+
+    QVector<StrokePoint> const & points(int id) const { return strokes_[id].points; }
+
+    // coarsest level within tolerance, level tolerance is put in levelTolerance
+    //  stroke in progress has only original points
+    QVector<StrokePoint> const & points(int id, qreal tolerance, qreal * levelTolerance = nullptr) const;
+
+    // ids of strokes, in order added
+    QVector<int> strokes() const;
+
+    // stroke in progress, -1 if none
+    int currentStroke() const { return current_; }
+
+    int key(int id) const { return strokes_[id].key; }
+
+    // stroke with greatest key not after key, -1 if none
+    int findStroke(int key) const;
+
+public:
+    // strokes with any segment in rect
+    QVector<int> query(QRect const & rect) const;
+
+    // strokes with any segment within radius of center (brush)
+    //  with tolerance, tested on level of it, may hit within radius + tolerance
+    QVector<int> query(QPoint const & center, qreal radius, qreal tolerance = 0) const;
+
+    // strokes with any segment within radius of polyline (eraser path)
+    QVector<int> query(QPolygon const & polyline, qreal radius, qreal tolerance = 0) const;
+
+    // strokes with all points inside polygon (lasso)
+    QVector<int> lasso(QPolygon const & polygon) const;
+
+private:
+    struct Stroke
+    {
+        int key = -1;
+        bool alive = false;
+        QRect bounds;
+        QVector<StrokePoint> points;
+        QVector<int> chunks;
+        StrokeLod lod; // when finished
+    };
+
+    struct Chunk
+    {
+        int stroke;
+        int first; // index of first point
+        int count;
+        QRect bounds;
+    };
+
+    void flushChunk(bool final);
+
+    // drop removed strokes, renumber others
+    void compact();
+
+    void insertChunk(int chunk);
+
+    void removeChunk(int chunk);
+
+    // candidate chunks in rect, each tested by test, strokes returned once
+    //  if perStroke, test is called once for each stroke (with any chunk)
+    template <typename Test>
+    QVector<int> search(QRect const & rect, bool perStroke, Test test) const;
+
+    template <typename Visit>
+    void visitCells(QRect const & rect, Visit visit) const;
+
+private:
+    int cellSize_;
+    QVector<Stroke> strokes_;
+    QVector<Chunk> chunks_;
+    QVector<int> freeChunks_;
+    QHash<int, int> keys_;
+    QHash<quint32, QVector<int>> cells_;
+    int count_ = 0;
+    int current_ = -1; // stroke in progress
+    int chunkFirst_ = 0; // first point of chunk in progress
+    mutable QVector<int> marks_; // of strokes
+    mutable QVector<int> chunkMarks_;
+    mutable int mark_ = 0;
+};
+
+#endif // STROKESINDEX_H
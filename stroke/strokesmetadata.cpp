@@ -0,0 +1,40 @@
+#include "strokesmetadata.h"
+
+StrokesMetadataBuilder::StrokesMetadataBuilder(const StrokePoint &max)
+    : decoder_(max.t != 0)
+{
+}
+
+void StrokesMetadataBuilder::add(const StrokePoint &point)
+{
+    add(&point, 1);
+}
+
+void StrokesMetadataBuilder::add(const StrokePoint *points, int count)
+{
+    decoder_.decode(points, count, block_);
+    for (uchar s : block_.state) {
+        if (!s && !inStroke_)
+            ++strokeCount_;
+        inStroke_ = !s;
+    }
+    pointCount_ += count;
+    if (!block_.isEmpty()) {
+        minX_ = qMin(minX_, block_.minX);
+        minY_ = qMin(minY_, block_.minY);
+        maxX_ = qMax(maxX_, block_.maxX);
+        maxY_ = qMax(maxY_, block_.maxY);
+    }
+}
+
+StrokesMetadata StrokesMetadataBuilder::result() const
+{
+    StrokesMetadata meta;
+    meta.valid = true;
+    meta.duration = decoder_.time();
+    meta.pointCount = pointCount_;
+    meta.strokeCount = strokeCount_;
+    if (minX_ <= maxX_)
+        meta.bounds = QRect(QPoint(minX_, minY_), QPoint(maxX_, maxY_));
+    return meta;
+}
@@ -0,0 +1,48 @@
+#ifndef STROKESMETADATA_H
+#define STROKESMETADATA_H
+
+#include "ShowBoard_global.h"
+
+#include "strokedecoder.h"
+
+#include <QRect>
+
+class SHOWBOARD_EXPORT StrokesMetadata
+{
+public:
+    bool valid = false;
+    int duration = 0; // in point time, same as StrokesRenderer::t()
+    int pointCount = 0;
+    int strokeCount = 0;
+    QRect bounds;
+};
+
+/*
+ * Collect metadata from points, time is unwrapped as StrokesRenderer does
+ */
+
+class SHOWBOARD_EXPORT StrokesMetadataBuilder
+{
+public:
+    StrokesMetadataBuilder(StrokePoint const & max);
+
+public:
+    void add(StrokePoint const & point);
+
+    void add(StrokePoint const * points, int count);
+
+    StrokesMetadata result() const;
+
+private:
+    StrokeDecoder decoder_;
+    StrokeDecoder::Block block_;
+    bool inStroke_ = false;
+    int pointCount_ = 0;
+    int strokeCount_ = 0;
+    ushort minX_ = 0xffff;
+    ushort minY_ = 0xffff;
+    ushort maxX_ = 0;
+    ushort maxY_ = 0;
+};
+
+#endif // STROKESMETADATA_H
@@ -0,0 +1,382 @@
+#include "strokesmixer.h"
+#include "strokesreader.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <climits>
+
+static constexpr int FILL = 64; // points read from one stream at a time
+static constexpr int LOG_SIZE = 1024; // must cover points read but not delivered
+
+/*
+ * Merge of stream readers, ordered by absolute time
+ *  merged points are all non stroke points (s = 1) with time in mix unit,
+ *  stream index and original state are kept in log_ by byte position, that
+ *  is sequence of point (position after point)
+ */
+class StrokesMixReader : public StrokesReader
+{
+public:
+    StrokesMixReader()
+        : StrokesReader(nullptr)
+    {
+        log_.resize(LOG_SIZE);
+    }
+
+public:
+    int add(StrokesReader * reader, int offset)
+    {
+        Source src;
+        src.reader = reader;
+        src.offset = qMax(offset, 0);
+        src.buffer.resize(FILL);
+        sources_.append(src);
+        return sources_.size() - 1;
+    }
+
+    StrokePoint const & maximun(int index) const
+    {
+        return sources_[index].max;
+    }
+
+    bool lookup(int bytePos, int & index, StrokePoint & point) const
+    {
+        Entry const & e = log_[bytePos & (LOG_SIZE - 1)];
+        if (e.seq != bytePos)
+            return false;
+        index = e.source;
+        point.t = e.t;
+        point.s = e.s;
+        return true;
+    }
+
+public:
+    virtual bool getMaximun(StrokePoint & max) override
+    {
+        if (!started_ && !start())
+            return false;
+        max = max_;
+        return true;
+    }
+
+    virtual bool getMetadata(StrokesMetadata & meta) override
+    {
+        if (!started_ && !start())
+            return false;
+        StrokesMetadata result;
+        int end = 0;
+        for (Source & src : sources_) {
+            if (src.max.s == 0) // no head
+                continue;
+            StrokesMetadata m;
+            if (!src.reader->getMetadata(m))
+                return false;
+            result.pointCount += m.pointCount;
+            result.strokeCount += m.strokeCount;
+            result.bounds |= m.bounds;
+            end = qMax(end, src.offset + (src.max.t ? m.duration * src.max.t : m.duration));
+        }
+        result.valid = true;
+        result.duration = (end - begin_) / max_.t;
+        meta = result;
+        return true;
+    }
+
+    virtual bool seek(int bytePos) override
+    {
+        if (started_ && bytePos == seq_)
+            return true;
+        if (!started_ && bytePos == 0)
+            return true;
+        if (started_) {
+            for (Source & src : sources_)
+                src.reader->seek(0);
+            started_ = false;
+            seq_ = 0;
+        }
+        StrokePoint point;
+        int pos = 0;
+        while (seq_ < bytePos) {
+            if (!read(point, pos))
+                return false;
+        }
+        return true;
+    }
+
+    virtual int bytePos() override
+    {
+        return seq_;
+    }
+
+    virtual bool read(StrokePoint & point, int & bytePos) override
+    {
+        if (!started_ && !start())
+            return false;
+        if (heap_.isEmpty())
+            return false;
+        auto later = [this] (int l, int r) { return this->later(l, r); };
+        std::pop_heap(heap_.begin(), heap_.end(), later);
+        int index = heap_.last();
+        Source & src = sources_[index];
+        StrokePoint const & p = src.buffer[src.pos];
+        point = p;
+        point.s = 1;
+        // start from 1, renderer keeps time 0 while previous t is 0
+        point.t = static_cast<ushort>((src.head - begin_) / max_.t + 1);
+        bytePos = ++seq_;
+        Entry & e = log_[seq_ & (LOG_SIZE - 1)];
+        e.seq = seq_;
+        e.source = index;
+        e.t = p.t;
+        e.s = p.s;
+        src.time = src.next;
+        src.last = p;
+        ++src.pos;
+        if (fill(src))
+            std::push_heap(heap_.begin(), heap_.end(), later);
+        else
+            heap_.removeLast();
+        return true;
+    }
+
+    virtual bool startAsyncRead(AsyncHandler handler) override
+    {
+        (void) handler;
+        return false;
+    }
+
+    virtual void stopAsyncRead() override
+    {
+    }
+
+    virtual void close() override
+    {
+    }
+
+private:
+    struct Source
+    {
+        StrokesReader * reader = nullptr;
+        int offset = 0; // ms
+        StrokePoint max = {0, 0, 0, 0, 0};
+        QVector<StrokePoint> buffer;
+        int size = 0;
+        int pos = 0;
+        StrokePoint last = StrokePoint::EndStorke;
+        int time = 0; // point time of last
+        int next = 0; // point time of buffer[pos]
+        int head = 0; // absolute time (ms) of buffer[pos]
+    };
+
+    struct Entry
+    {
+        int seq = -1;
+        int source = 0;
+        ushort t = 0;
+        bool s = true;
+    };
+
+    // read heads of all streams, and first points
+    bool start()
+    {
+        max_ = StrokePoint::EndStorke;
+        max_.t = 0;
+        begin_ = INT_MAX;
+        heap_.clear();
+        for (int i = 0; i < sources_.size(); ++i) {
+            Source & src = sources_[i];
+            src.size = src.pos = 0;
+            src.last = StrokePoint::EndStorke;
+            src.time = src.next = 0;
+            src.max = {0, 0, 0, 0, 0};
+            if (!src.reader->getMaximun(src.max)) {
+                qWarning() << "StrokesMixer bad stream" << i;
+                src.max.s = 0;
+                continue;
+            }
+            max_.x = qMax(max_.x, src.max.x);
+            max_.y = qMax(max_.y, src.max.y);
+            max_.p = qMax<ushort>(max_.p, src.max.p);
+            if (src.max.t && (max_.t == 0 || src.max.t < max_.t))
+                max_.t = src.max.t;
+            if (fill(src)) {
+                heap_.append(i);
+                begin_ = qMin(begin_, src.head);
+            }
+        }
+        if (max_.t == 0)
+            max_.t = 1;
+        if (begin_ == INT_MAX)
+            begin_ = 0;
+        auto later = [this] (int l, int r) { return this->later(l, r); };
+        std::make_heap(heap_.begin(), heap_.end(), later);
+        seq_ = 0;
+        started_ = true;
+        return true;
+    }
+
+    // make sure next point is available, and time it same as renderer
+    bool fill(Source & src)
+    {
+        if (src.pos >= src.size) {
+            src.pos = 0;
+            src.size = src.reader->readBatch(src.buffer.data(), nullptr, FILL);
+            if (src.size <= 0) {
+                src.size = 0;
+                return false;
+            }
+        }
+        StrokePoint const & p = src.buffer[src.pos];
+        int time = src.time;
+        if (src.max.t) {
+            if (time > 0)
+                time += (p.t - src.last.t) & 0xffff;
+            else if (src.last.t != 0)
+                time = (p.t - src.last.t) & 0xffff;
+        } else {
+            time += 10;
+        }
+        src.next = time;
+        src.head = src.offset + (src.max.t ? time * src.max.t : time);
+        return true;
+    }
+
+    // heap order, earliest on top, stream order on same time
+    bool later(int l, int r) const
+    {
+        Source const & sl = sources_[l];
+        Source const & sr = sources_[r];
+        return sl.head > sr.head || (sl.head == sr.head && l > r);
+    }
+
+private:
+    QVector<Source> sources_;
+    QVector<int> heap_;
+    QVector<Entry> log_;
+    StrokePoint max_ = {0, 0, 0, 0, 0};
+    int begin_ = 0; // absolute time of first point
+    int seq_ = 0;
+    bool started_ = false;
+};
+
+/* StrokesMixer */
+
+StrokesMixer::StrokesMixer(QObject *parent)
+    : StrokesRenderer(new StrokesMixReader, parent)
+{
+    mix_ = static_cast<StrokesMixReader*>(reader_);
+}
+
+int StrokesMixer::addStream(StrokesRenderer *renderer, int offset)
+{
+    if (isStarted())
+        return -1;
+    Stream stream;
+    stream.target = renderer;
+    streams_.append(stream);
+    return mix_->add(renderer->reader(), offset);
+}
+
+void StrokesMixer::seekTo(int time)
+{
+    if (!isStarted())
+        return;
+    int mt = maximun_.t ? maximun_.t : 1;
+    if (time >= this->time()) {
+        seek(time / mt, 0, -1, false);
+        return;
+    }
+    clearInk();
+    seek(time / mt, 0, 0, false);
+}
+
+void StrokesMixer::setMaximun(const StrokePoint &max)
+{
+    (void) max;
+    for (int i = 0; i < streams_.size(); ++i)
+        streams_[i].target->setMaximun(mix_->maximun(i));
+}
+
+void StrokesMixer::startStroke(const StrokePoint &point)
+{
+    route(point);
+}
+
+void StrokesMixer::addPoint(const StrokePoint &point)
+{
+    route(point);
+}
+
+void StrokesMixer::endStroke()
+{
+    // merged points never start stroke of mixer itself
+}
+
+void StrokesMixer::addNonStrokePoint(const StrokePoint &point)
+{
+    route(point);
+}
+
+void StrokesMixer::enterFastMode()
+{
+    for (Stream & s : streams_)
+        s.target->enterFastMode();
+}
+
+void StrokesMixer::leaveFastMode()
+{
+    for (Stream & s : streams_)
+        s.target->leaveFastMode();
+}
+
+void StrokesMixer::onFinish()
+{
+    endStrokes();
+    for (Stream & s : streams_)
+        s.target->onFinish();
+}
+
+void StrokesMixer::clearInk()
+{
+    for (Stream & s : streams_) {
+        s.inStroke = false;
+        s.target->clearInk();
+    }
+}
+
+void StrokesMixer::route(const StrokePoint &point)
+{
+    int index = 0;
+    StrokePoint p = point;
+    if (!mix_->lookup(b(), index, p)) {
+        qWarning() << "StrokesMixer lost point" << b();
+        return;
+    }
+    Stream & s = streams_[index];
+    if (!p.s) {
+        if (!s.inStroke) {
+            s.inStroke = true;
+            s.target->startStroke(p);
+        } else {
+            s.target->addPoint(p);
+        }
+    } else {
+        if (s.inStroke) {
+            s.target->endStroke();
+            s.inStroke = false;
+        } else {
+            s.target->addNonStrokePoint(p);
+        }
+    }
+}
+
+void StrokesMixer::endStrokes()
+{
+    for (Stream & s : streams_) {
+        if (s.inStroke) {
+            s.target->endStroke();
+            s.inStroke = false;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef STROKESMIXER_H
+#define STROKESMIXER_H
+
+#include "strokesrenderer.h"
+
+#include <QVector>
+
+class StrokesMixReader;
+
+/*
+ * Synchronized playback of several stroke streams (teacher plus students)
+ *  readers of added renderers are merged by absolute time with a k-way heap,
+ *  and played with one clock and one bump() loop; added renderers are only
+ *  used as ink targets, they should not be started themselves
+ *
+ * Streams are aligned by offset (ms) of their first point, the timeline of
+ *  mixer starts at the earliest stream. Only complete (non async) streams
+ *  are supported, threaded decode is not available.
+ */
+
+class SHOWBOARD_EXPORT StrokesMixer : public StrokesRenderer
+{
+    Q_OBJECT
+public:
+    explicit StrokesMixer(QObject *parent = nullptr);
+
+public:
+    // add before start, return index of stream
+    int addStream(StrokesRenderer * renderer, int offset = 0);
+
+    int streamCount() const { return streams_.size(); }
+
+    StrokesRenderer * stream(int index) const { return streams_[index].target; }
+
+    // reposition every stream to time (ms)
+    //  backward seek clears ink of targets and replays
+    void seekTo(int time);
+
+protected:
+    virtual void setMaximun(StrokePoint const & max) override;
+
+    virtual void startStroke(StrokePoint const & point) override;
+
+    virtual void addPoint(StrokePoint const & point) override;
+
+    virtual void endStroke() override;
+
+    virtual void addNonStrokePoint(StrokePoint const & point) override;
+
+    virtual void enterFastMode() override;
+
+    virtual void leaveFastMode() override;
+
+    virtual void onFinish() override;
+
+    virtual void clearInk() override;
+
+private:
+    // dispatch merged point to target of its stream
+    void route(StrokePoint const & point);
+
+    void endStrokes();
+
+private:
+    struct Stream
+    {
+        StrokesRenderer * target = nullptr;
+        bool inStroke = false;
+    };
+
+    StrokesMixReader * mix_;
+    QVector<Stream> streams_;
+};
+
+#endif // STROKESMIXER_H
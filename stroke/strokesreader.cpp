@@ -1,13 +1,26 @@
 ﻿#include "strokesreader.h"
 #include "showboard.h"
+#include "core/workthread.h"
 
 #include <qcomponentcontainer.h>
 #include <qlazy.hpp>
 
 #include <QIODevice>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutex>
 #include <QMetaClassInfo>
 
-StrokesReader *StrokesReader::createReader(QIODevice *stream, const QByteArray &format)
+using namespace QtPromise;
+
+static WorkThread& thread()
+{
+    static WorkThread th("StrokesReader");
+    return th;
+}
+
+static QMap<QByteArray, QLazy*> & readerTypes()
 {
     static QVector<QLazy> types;
     static QMap<QByteArray, QLazy*> readerTypes;
@@ -20,14 +33,24 @@ StrokesReader *StrokesReader::createReader(QIODevice *stream, const QByteArray &
              }
          }
     }
-    auto iter = readerTypes.find(format);
-    if (iter == readerTypes.end())
+    return readerTypes;
+}
+
+StrokesReader *StrokesReader::createReader(QIODevice *stream, const QByteArray &format)
+{
+    auto iter = readerTypes().find(format);
+    if (iter == readerTypes().end())
         return nullptr;
     StrokesReader * p = (*iter)->create<StrokesReader>(Q_ARG(QIODevice*,stream));
     p->setProperty(QPart::ATTR_MINE_TYPE, format);
     return p;
 }
 
+QList<QByteArray> StrokesReader::formats()
+{
+    return readerTypes().keys();
+}
+
 StrokesReader::StrokesReader(QIODevice * stream, QObject *parent)
     : QObject(parent)
     , stream_(stream)
@@ -57,6 +80,30 @@ int StrokesReader::bytePos()
     return static_cast<int>(stream_->pos());
 }
 
+bool StrokesReader::getMetadata(StrokesMetadata &meta)
+{
+    (void) meta;
+    return false;
+}
+
+int StrokesReader::readBatch(StrokePoint *points, int *bytePoses, int count)
+{
+    int n = 0;
+    int pos = 0;
+    for (; n < count && read(points[n], pos); ++n) {
+        if (bytePoses)
+            bytePoses[n] = pos;
+    }
+    return n;
+}
+
+bool StrokesReader::findIndex(int time, IndexPoint &index)
+{
+    (void) time;
+    (void) index;
+    return false;
+}
+
 bool StrokesReader::startAsyncRead(StrokesReader::AsyncHandler handler)
 {
     if (stream_->atEnd())
@@ -80,7 +127,8 @@ void StrokesReader::stopAsyncRead()
 
 void StrokesReader::close()
 {
-    stream_->close();
+    if (stream_)
+        stream_->close();
 }
 
 void StrokesReader::storeStreamLife(QSharedPointer<QIODevice> stream)
@@ -88,3 +136,56 @@ void StrokesReader::storeStreamLife(QSharedPointer<QIODevice> stream)
     assert(stream.get() == stream_);
     stream2_ = stream;
 }
+
+QPromise<StrokesMetadata> StrokesReader::scanMetadata()
+{
+    StrokesMetadata meta;
+    if (getMetadata(meta))
+        return QPromise<StrokesMetadata>::resolve(meta);
+    QFile * file = qobject_cast<QFile*>(stream_);
+    if (file == nullptr)
+        return QPromise<StrokesMetadata>::reject(std::invalid_argument("not local file"));
+    static QMutex mutex;
+    static QMap<QString, StrokesMetadata> cache;
+    QFileInfo info(file->fileName());
+    QString key = QString("%1|%2|%3").arg(info.absoluteFilePath()).arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch());
+    {
+        QMutexLocker l(&mutex);
+        auto iter = cache.find(key);
+        if (iter != cache.end())
+            return QPromise<StrokesMetadata>::resolve(iter.value());
+    }
+    QString fileName = file->fileName();
+    QByteArray format = property(QPart::ATTR_MINE_TYPE).toByteArray();
+    // lazy registry is not thread safe, create reader on worker after it
+    readerTypes();
+    return thread().asyncWork([fileName, format, key] () {
+        QFile * file = new QFile(fileName);
+        if (!file->open(QFile::ReadOnly)) {
+            std::string error = file->errorString().toStdString();
+            delete file;
+            throw std::runtime_error(error);
+        }
+        QScopedPointer<StrokesReader> reader(createReader(file, format));
+        if (!reader) {
+            delete file;
+            throw std::runtime_error("StrokeReader not found");
+        }
+        StrokePoint max;
+        if (!reader->getMaximun(max))
+            throw std::runtime_error("bad stroke file");
+        StrokesMetadata meta;
+        if (!reader->getMetadata(meta)) {
+            StrokesMetadataBuilder builder(max);
+            StrokePoint points[256];
+            int n = 0;
+            while ((n = reader->readBatch(points, nullptr, 256)) > 0)
+                builder.add(points, n);
+            meta = builder.result();
+        }
+        QMutexLocker l(&mutex);
+        cache.insert(key, meta);
+        return meta;
+    });
+}
@@ -4,9 +4,11 @@
 #include "ShowBoard_global.h"
 
 #include "strokepoint.h"
+#include "strokesmetadata.h"
 
 #include <QObject>
 #include <QSharedPointer>
+#include <QtPromise>
 
 #include <functional>
 
@@ -18,8 +20,24 @@ class SHOWBOARD_EXPORT StrokesReader : public QObject
 public:
     typedef std::function<void (StrokePoint const & point, int bytePos)> AsyncHandler;
 
+    // renderer state just before reading the point at bytePos
+    struct IndexPoint
+    {
+        int bytePos = 0;
+        int time = 0; // accumulated time of previous point
+        ushort t = 0; // raw time of previous point
+        bool inStroke = false;
+        // state before the first point of the stroke containing bytePos
+        int strokeByte = 0;
+        int strokeTime = 0;
+        ushort strokeT = 0;
+    };
+
     static StrokesReader * createReader(QIODevice * stream, QByteArray const & format);
 
+    // registered formats, also initialize registry before using on other threads
+    static QList<QByteArray> formats();
+
 public:
     StrokesReader(QIODevice * stream, QObject *parent = nullptr);
 
@@ -34,12 +52,26 @@ public:
 public:
     virtual bool getMaximun(StrokePoint & max);
 
+    // metadata from head or trailer, return false if not available
+    virtual bool getMetadata(StrokesMetadata & meta);
+
     virtual bool seek(int bytePos);
 
     virtual int bytePos();
 
     virtual bool read(StrokePoint & point, int & bytePos) = 0;
 
+    // read at most count points, bytePoses (if not null) receive position after each point
+    //  return number of points read
+    virtual int readBatch(StrokePoint * points, int * bytePoses, int count);
+
+    // find last index point with time not after time, return false if not indexed
+    virtual bool findIndex(int time, IndexPoint & index);
+
+    // all points are read, by end mark of format; false if format has none,
+    //  then points end with stream
+    virtual bool atEnd() { return false; }
+
     virtual bool startAsyncRead(AsyncHandler handler);
 
     virtual void stopAsyncRead();
@@ -49,7 +81,12 @@ public:
 public:
     void storeStreamLife(QSharedPointer<QIODevice> stream);
 
+    // getMetadata(), or scan whole local file on worker thread, result is cached
+    QtPromise::QPromise<StrokesMetadata> scanMetadata();
+
 protected:
+    friend class ThreadedStrokesDecoder;
+
     QIODevice * stream_;
     QSharedPointer<QIODevice> stream2_;
 };
@@ -1,40 +1,64 @@
 #include "strokesrenderer.h"
 #include "strokesreader.h"
+#include "strokescheckpoints.h"
+#include "strokesclock.h"
+#include "threadedstrokesdecoder.h"
+#include "strokesimplifier.h"
+#include "strokesindex.h"
 
-#include <QElapsedTimer>
 #include <QDebug>
 
 static constexpr int INTERVAL = 20; // ms (tick)
+static constexpr int BATCH = 256; // points
 
 StrokesRenderer::StrokesRenderer(StrokesReader* reader, QObject *parent)
     : LifeObject(parent)
     , reader_(reader)
     , maximun_(StrokePoint::EndStorke)
     , point_(StrokePoint::EndStorke)
+    , batch_(BATCH)
+    , batchBytes_(BATCH)
 {
     reader->setParent(this);
     connect(reader, &StrokesReader::asyncFinished, this, &StrokesRenderer::asyncFinished);
 }
 
-static QElapsedTimer startTick()
+StrokesRenderer::~StrokesRenderer()
 {
-    QElapsedTimer t;
-    t.start();
-    return t;
+    // before reader (child) is deleted, it is reading decoder's pipe now
+    if (decoder_) {
+        decoder_->stop();
+        delete decoder_;
+        decoder_ = nullptr;
+    }
+    if (clock_)
+        clock_->cancel(this);
+    delete checkpoints_;
+    delete simplifier_;
+    delete index_;
+}
+
+void StrokesRenderer::setClock(StrokesClock *clock)
+{
+    if (started_)
+        return;
+    clock_ = clock;
 }
 
-static int tickCount()
+int StrokesRenderer::tickCount() const
 {
-    static QElapsedTimer t = startTick();
-    return static_cast<int>(t.elapsed());
+    return clock_ ? clock_->now() : 0;
 }
 
 bool StrokesRenderer::start()
 {
-    if (timer_)
+    if (started_)
         return false;
     if (!reader_->getMaximun(maximun_))
         return false;
+    // shared clock lives on GUI thread, renderers may be created on others
+    if (clock_ == nullptr)
+        clock_ = StrokesClock::instance();
     if (maximun_.t) {
         interval_ = INTERVAL < maximun_.t ? 1 : INTERVAL / maximun_.t;
         if (rate_ > 0)
@@ -43,9 +67,15 @@ bool StrokesRenderer::start()
         rate_ = rate_ / maximun_.t;
     }
     setMaximun(maximun_);
-    timer_ = new QTimer(this);
-    timer_->setSingleShot(true);
-    connect(timer_, &QTimer::timeout, this, &StrokesRenderer::bump);
+    if (!reader_->getMetadata(meta_) && scanMeta_) {
+        reader_->scanMetadata().then([l = life(), this] (StrokesMetadata const & meta) {
+            if (l.isNull())
+                return;
+            meta_ = meta;
+            emit positionChanged();
+        });
+    }
+    started_ = true;
     startTime_ = tickCount();
     bump();
     return true;
@@ -73,6 +103,66 @@ void StrokesRenderer::setMaxGap(int time)
     maxGap_ = time;
 }
 
+void StrokesRenderer::setThreadedDecode(bool threaded)
+{
+    threaded_ = threaded;
+}
+
+void StrokesRenderer::setCheckpoints(int interval, qint64 budget)
+{
+    delete checkpoints_;
+    checkpoints_ = interval > 0 ? new StrokesCheckpoints(interval, budget) : nullptr;
+}
+
+void StrokesRenderer::setIndexed(bool indexed)
+{
+    if (indexed == (index_ != nullptr))
+        return;
+    if (indexed) {
+        index_ = new StrokesIndex;
+    } else {
+        delete index_;
+        index_ = nullptr;
+    }
+}
+
+bool StrokesRenderer::redrawIndexed(qreal tolerance)
+{
+    if (index_ == nullptr)
+        return false;
+    flushPoints();
+    clearInk();
+    int current = index_->currentStroke();
+    for (int id : index_->strokes()) {
+        QVector<StrokePoint> const & points = index_->points(id, tolerance);
+        startStroke(points.first());
+        if (points.size() > 1)
+            addPoints(points.constData() + 1, points.size() - 1);
+        // stroke in progress goes on with next points
+        if (id != current || !strokeStarted_)
+            endStroke();
+    }
+    return true;
+}
+
+qreal StrokesRenderer::simplifyTolerance() const
+{
+    return simplifier_ ? simplifier_->tolerance() : 0;
+}
+
+void StrokesRenderer::setSimplifyTolerance(qreal tolerance)
+{
+    if (tolerance <= 0) {
+        delete simplifier_;
+        simplifier_ = nullptr;
+    } else if (simplifier_) {
+        simplifier_->setTolerance(tolerance);
+    } else {
+        simplifier_ = new StrokeSimplifier(tolerance);
+        simplifier_->start(point_);
+    }
+}
+
 int StrokesRenderer::time() const
 {
     if (rate_ > 0)
@@ -84,6 +174,8 @@ int StrokesRenderer::time() const
 int StrokesRenderer::duration() const
 {
     int tm = qMax(time_, maxTime_);
+    if (meta_.valid && maxGap_ == 0)
+        tm = qMax(tm, meta_.duration);
     return maximun_.t ? tm * maximun_.t : tm;
 }
 
@@ -106,9 +198,11 @@ void StrokesRenderer::pause()
             startTime_ = static_cast<int>((tickCount() - startTime_) * rate_);
         //qDebug() << "pause" << startTime_;
         paused_ = true;
-        if (time_ >= seekTime_)
-            timer_->stop();
-        stopAsync();
+        if (time_ >= seekTime_ || decoder_)
+            clock_->cancel(this);
+        // decoder keeps its place, resume takes from it without seeking stream
+        if (decoder_ == nullptr)
+            stopAsync();
     }
 }
 
@@ -127,14 +221,8 @@ void StrokesRenderer::seek(int time, int time2, int byte, bool inStroke)
 {
     qDebug() << "seek" << time << time2 << byte <<inStroke;
     if (byte >= 0) {
+        saveMaxPosition();
         stopAsync();
-        // save max position
-        byte_ = reader_->bytePos();
-        if (byte_ > maxByte_) {
-            maxByte_ = byte_;
-            maxTime_ = time_; // previous point time
-            maxInStroke_ = strokeStarted_;
-        }
         // seek to end (max) or after end
         if (time < 0 || time > maxTime_) {
             if (time < 0)
@@ -145,6 +233,8 @@ void StrokesRenderer::seek(int time, int time2, int byte, bool inStroke)
         }
         qDebug() << "seek" << time << time2 << byte <<inStroke;
         reader_->seek(byte);
+        resetBatch();
+        seekIndex(byte, inStroke);
         byte_ = byte;
         // after adjust, next point read will has 0 diff
         // also can be previous point time
@@ -153,6 +243,111 @@ void StrokesRenderer::seek(int time, int time2, int byte, bool inStroke)
         pending_ = false;
         strokeStarted_ = inStroke;
     }
+    seekPlay(time);
+}
+
+bool StrokesRenderer::seekToTime(int time, bool restartStroke)
+{
+    StrokesReader::IndexPoint index;
+    if (!reader_->findIndex(time, index))
+        return false;
+    qDebug() << "seekToTime" << time << index.time << index.bytePos << index.inStroke;
+    saveMaxPosition();
+    stopAsync();
+    if (restartStroke && index.inStroke) {
+        index.bytePos = index.strokeByte;
+        index.time = index.strokeTime;
+        index.t = index.strokeT;
+        index.inStroke = false;
+    }
+    reader_->seek(index.bytePos);
+    resetBatch();
+    seekIndex(index.bytePos, index.inStroke);
+    byte_ = index.bytePos;
+    // restore state of previous point, forward scan to time in bump()
+    point_.t = index.t;
+    time_ = index.time;
+    pending_ = false;
+    strokeStarted_ = index.inStroke;
+    seekPlay(time);
+    return true;
+}
+
+bool StrokesRenderer::seekToCheckpoint(int time)
+{
+    if (checkpoints_ == nullptr)
+        return false;
+    int mt = maximun_.t ? maximun_.t : 1;
+    StrokesCheckpoints::Checkpoint const * c = checkpoints_->find(time * mt);
+    if (c == nullptr)
+        return false;
+    // continue reading is cheaper
+    if (time >= time_ && c->pointTime <= time_)
+        return false;
+    qDebug() << "seekToCheckpoint" << time << c->pointTime << c->byte << c->inStroke;
+    saveMaxPosition();
+    stopAsync();
+    restoreSnapshot(c->image);
+    reader_->seek(c->byte);
+    resetBatch();
+    seekIndex(c->byte, c->inStroke);
+    byte_ = c->byte;
+    point_ = c->point;
+    time_ = c->pointTime;
+    pending_ = false;
+    strokeStarted_ = c->inStroke;
+    strokeTime_ = c->strokeTime;
+    strokeByte_ = c->strokeByte;
+    if (strokeStarted_) {
+        startStroke(point_); // continue from last point
+        if (simplifier_)
+            simplifier_->start(point_);
+    }
+    seekPlay(time);
+    return true;
+}
+
+// later strokes are replayed again, or not at all; stroke in progress at
+//  byte is indexed again from its start, reader is left at byte
+void StrokesRenderer::seekIndex(int byte, bool inStroke)
+{
+    if (index_ == nullptr)
+        return;
+    index_->truncate(byte);
+    int id = inStroke ? index_->findStroke(byte) : -1;
+    if (id < 0)
+        return;
+    int key = index_->key(id);
+    StrokePoint point = index_->points(id).first();
+    index_->startStroke(point, key);
+    if (key >= byte)
+        return;
+    StrokeSimplifier simplifier(simplifier_ ? simplifier_->tolerance() : 0);
+    simplifier.start(point);
+    reader_->seek(key);
+    int pos = key;
+    while (pos < byte && reader_->read(point, pos)) {
+        if (simplifier_ && !simplifier.filter(&point, 1, &point))
+            continue;
+        index_->addPoint(point);
+    }
+    reader_->seek(byte);
+}
+
+void StrokesRenderer::saveMaxPosition()
+{
+    // else byte_ is consumed position, decoder reads ahead on its thread
+    if (batchPos_ >= batchSize_ && decoder_ == nullptr)
+        byte_ = reader_->bytePos();
+    if (byte_ > maxByte_) {
+        maxByte_ = byte_;
+        maxTime_ = time_; // previous point time
+        maxInStroke_ = strokeStarted_;
+    }
+}
+
+void StrokesRenderer::seekPlay(int time)
+{
     seekTime_ = time;
     notifyTime_ = time;
     finished_ = false;
@@ -171,11 +366,12 @@ void StrokesRenderer::seek(int time, int time2, int byte, bool inStroke)
 
 void StrokesRenderer::stop()
 {
-    if (timer_ == nullptr)
+    if (!started_)
         return;
     pause();
     if (byte_)
         reader_->seek(0);
+    resetBatch();
     point_ = StrokePoint::EndStorke;
     time_ = 0;
     byte_ = 0;
@@ -188,8 +384,9 @@ void StrokesRenderer::stop()
     startTime_ = 0;
     sleepTime_ = 0;
     seekTime_ = 0;
-    delete timer_;
-    timer_ = nullptr;
+    if (clock_)
+        clock_->cancel(this);
+    started_ = false;
 }
 
 /*
@@ -201,6 +398,10 @@ void StrokesRenderer::stop()
  */
 void StrokesRenderer::bump()
 {
+    if (decoder_) {
+        drainAsync();
+        return;
+    }
     if (time_ >= notifyTime_ && rate_ > 0 && time_ >= seekTime_) {
         notifyTime_ += (maximun_.t ? 1000 / maximun_.t : 1000);
         emit positionChanged();
@@ -209,12 +410,14 @@ void StrokesRenderer::bump()
             qDebug() << "bump gap continue" << d;
             d = 1000;
         }
-        timer_->start(d < 0 ? 0 : d);
+        clock_->schedule(this, d);
         return;
     }
     if (pending_) {
         addPoint2(point_);
         pending_ = false;
+        if (checkpoints_)
+            checkpoint();
     }
     if (finished_)
         return;
@@ -226,22 +429,14 @@ void StrokesRenderer::bump()
         fastMode_ ? enterFastMode() : leaveFastMode();
         emit positionChanged();
     }
-    while (reader_->read(point, byte_)) {
+    while (readPoint(point)) {
         //qDebug() << "bump" << byte_ << point.t << point.x << point.y;
-        if (maximun_.t) {
-            if (time_ > 0) {
-                time_ += (point.t - point_.t) & 0xffff;
-                assert(time_ > 0);
-            } else if (point_.t != 0) {
-                time_ = (point.t - point_.t) & 0xffff;
-            }
-        } else {
-            time_ += 10;
-        }
+        updateTime(point);
         point_ = point;
         //assert(time_ < 1000);
         //qDebug() << "bump" << time_;
         if (time_ >= sleepTime_) {
+            flushPoints();
             //qDebug() << "bump" << time_ << sleepTime_;
             if (paused_ && time_ >= seekTime_) {
                 emit positionChanged();
@@ -260,9 +455,9 @@ void StrokesRenderer::bump()
                     qDebug() << "bump gap" << d;
                     d = 1000;
                 }
-                timer_->start(d < 0 ? 0 : d);
+                clock_->schedule(this, d);
             } else { // rate_ == 0 || time_ < seekTime_, but new time_ may > seekTime_
-                timer_->start(0); // restart when idle
+                clock_->schedule(this, 0); // restart when idle
             }
             if (time_ >= notifyTime_) {
                 notifyTime_ += (maximun_.t ? 1000 / maximun_.t : 1000);
@@ -272,7 +467,9 @@ void StrokesRenderer::bump()
             pending_ = true;
             return;
         }
-        addPoint2(point);
+        deliverPoint(point);
+        if (checkpoints_)
+            checkpoint();
     }
     seekTime_ = time_; // can't fast seek any more
     if (!paused_)
@@ -282,24 +479,31 @@ void StrokesRenderer::bump()
 void StrokesRenderer::startAsync()
 {
     qDebug() << "startAsync" << byte_;
-    bool async = reader_->startAsyncRead([l = life(), this] (StrokePoint const & point, int bytePos) {
-        if (!l.isNull()) {
-            byte_ = bytePos;
-            //qDebug() << "async" << byte_ << point.t << point.x << point.y;
-            if (maximun_.t) {
-                if (time_ > 0) {
-                    time_ += (point.t - point_.t) & 0xffff;
-                } else if (point_.t != 0) {
-                    time_ = (point.t - point_.t) & 0xffff;
-                }
-            } else {
-                time_ += 10;
-            }
-            //qDebug() << "async" << byte_ << time_;
-            point_ = point;
-            addPoint2(point);
+    bool async = false;
+    // reader without stream has its own async reading
+    if (threaded_ && reader_->stream()) {
+        decoder_ = new ThreadedStrokesDecoder(reader_, this);
+        async = decoder_->start();
+        if (async) {
+            clock_->schedule(this, INTERVAL);
+        } else {
+            delete decoder_;
+            decoder_ = nullptr;
         }
-    });
+    } else {
+        async = reader_->startAsyncRead([l = life(), this] (StrokePoint const & point, int bytePos) {
+            if (!l.isNull()) {
+                byte_ = bytePos;
+                //qDebug() << "async" << byte_ << point.t << point.x << point.y;
+                updateTime(point);
+                //qDebug() << "async" << byte_ << time_;
+                point_ = point;
+                addPoint2(point);
+                if (checkpoints_)
+                    checkpoint();
+            }
+        });
+    }
     if (async) {
         asyncStarted_ = true;
         if (fastMode_) {
@@ -312,11 +516,44 @@ void StrokesRenderer::startAsync()
     }
 }
 
+void StrokesRenderer::drainAsync()
+{
+    batchSize_ = decoder_->take(batch_.data(), batchBytes_.data(), batch_.size());
+    batchPos_ = 0;
+    StrokePoint point;
+    while (batchPos_ < batchSize_) {
+        point = batch_[batchPos_];
+        byte_ = batchBytes_[batchPos_];
+        ++batchPos_;
+        updateTime(point);
+        point_ = point;
+        deliverPoint(point);
+        if (checkpoints_)
+            checkpoint();
+    }
+    flushPoints();
+    bool full = batchSize_ == batch_.size();
+    resetBatch();
+    if (decoder_->isFinished()) {
+        asyncFinished();
+        return;
+    }
+    clock_->schedule(this, full ? 0 : INTERVAL);
+}
+
 void StrokesRenderer::stopAsync()
 {
     if (asyncStarted_) {
-        // reader should keep position valid in async mode
-        reader_->stopAsyncRead();
+        if (decoder_) {
+            // points decoded but not taken are dropped, seeks move reader
+            decoder_->stop();
+            delete decoder_;
+            decoder_ = nullptr;
+            clock_->cancel(this);
+        } else {
+            // reader should keep position valid in async mode
+            reader_->stopAsyncRead();
+        }
         asyncStarted_ = false;
     }
 }
@@ -331,10 +568,8 @@ void StrokesRenderer::asyncFinished()
 
 void StrokesRenderer::finish()
 {
-    if (strokeStarted_) {
-        endStroke();
-        strokeStarted_ = false;
-    }
+    if (strokeStarted_)
+        endStroke2();
     emit positionChanged();
     if (fastMode_) {
         fastMode_ = false;
@@ -346,6 +581,98 @@ void StrokesRenderer::finish()
     emit finished();
 }
 
+void StrokesRenderer::checkpoint()
+{
+    int mt = maximun_.t ? maximun_.t : 1;
+    if (!checkpoints_->due(time_ * mt))
+        return;
+    flushPoints();
+    StrokesCheckpoints::Checkpoint c;
+    if (!saveSnapshot(c.image))
+        return;
+    c.time = time_ * mt;
+    c.pointTime = time_;
+    c.byte = byte_;
+    c.point = point_;
+    c.inStroke = strokeStarted_;
+    c.strokeTime = strokeTime_;
+    c.strokeByte = strokeByte_;
+    checkpoints_->add(c);
+}
+
+void StrokesRenderer::updateTime(const StrokePoint &point)
+{
+    if (maximun_.t) {
+        if (time_ > 0) {
+            time_ += (point.t - point_.t) & 0xffff;
+            assert(time_ > 0);
+        } else if (point_.t != 0) {
+            time_ = (point.t - point_.t) & 0xffff;
+        }
+    } else {
+        time_ += 10;
+    }
+}
+
+void StrokesRenderer::addPoints(const StrokePoint *points, int count)
+{
+    for (int i = 0; i < count; ++i)
+        addPoint(points[i]);
+}
+
+bool StrokesRenderer::readPoint(StrokePoint &point)
+{
+    if (batchPos_ >= batchSize_) {
+        flushPoints(); // run is in old batch
+        batchPos_ = 0;
+        batchSize_ = reader_->readBatch(batch_.data(), batchBytes_.data(), batch_.size());
+        if (batchSize_ <= 0) {
+            batchSize_ = 0;
+            return false;
+        }
+    }
+    point = batch_[batchPos_];
+    byte_ = batchBytes_[batchPos_];
+    ++batchPos_;
+    return true;
+}
+
+void StrokesRenderer::resetBatch()
+{
+    batchSize_ = 0;
+    batchPos_ = 0;
+    runCount_ = 0;
+}
+
+// point must be the last one returned by readPoint()
+void StrokesRenderer::deliverPoint(const StrokePoint &point)
+{
+    if (strokeStarted_ && !point.s) {
+        if (runCount_ == 0)
+            runStart_ = batchPos_ - 1;
+        ++runCount_;
+    } else {
+        flushPoints();
+        addPoint2(point);
+    }
+}
+
+void StrokesRenderer::flushPoints()
+{
+    if (runCount_) {
+        int count = runCount_;
+        if (simplifier_) // in place, points are consumed
+            count = simplifier_->filter(batch_.constData() + runStart_, count,
+                                        batch_.data() + runStart_);
+        if (count) {
+            addPoints(batch_.constData() + runStart_, count);
+            if (index_)
+                index_->addPoints(batch_.constData() + runStart_, count);
+        }
+        runCount_ = 0;
+    }
+}
+
 void StrokesRenderer::addPoint2(const StrokePoint &point)
 {
     if (!point.s) {
@@ -354,15 +681,38 @@ void StrokesRenderer::addPoint2(const StrokePoint &point)
             strokeTime_ = time_;
             strokeByte_ = byte_;
             startStroke(point);
+            if (simplifier_)
+                simplifier_->start(point);
+            if (index_)
+                index_->startStroke(point, strokeByte_);
         } else {
-            addPoint(point);
+            StrokePoint p = point;
+            if (simplifier_ && !simplifier_->filter(&point, 1, &p))
+                return;
+            addPoint(p);
+            if (index_)
+                index_->addPoint(p);
         }
     } else {
         if (strokeStarted_) {
-            endStroke();
-            strokeStarted_ = false;
+            endStroke2();
         } else {
             addNonStrokePoint(point);
         }
     }
 }
+
+// add point held back by simplifier, keep end of stroke
+void StrokesRenderer::endStroke2()
+{
+    StrokePoint point;
+    if (simplifier_ && simplifier_->finish(point)) {
+        addPoint(point);
+        if (index_)
+            index_->addPoint(point);
+    }
+    endStroke();
+    if (index_)
+        index_->endStroke();
+    strokeStarted_ = false;
+}
@@ -5,10 +5,18 @@
 #include "core/lifeobject.h"
 
 #include "strokepoint.h"
+#include "strokesmetadata.h"
 
+#include <QImage>
+#include <QVector>
 #include <QTimer>
 
 class StrokesReader;
+class StrokesCheckpoints;
+class StrokesClock;
+class ThreadedStrokesDecoder;
+class StrokeSimplifier;
+class StrokesIndex;
 
 class SHOWBOARD_EXPORT StrokesRenderer : public LifeObject
 {
@@ -16,9 +24,17 @@ class SHOWBOARD_EXPORT StrokesRenderer : public LifeObject
 public:
     explicit StrokesRenderer(StrokesReader* reader, QObject *parent = nullptr);
 
+    virtual ~StrokesRenderer() override;
+
 public:
     StrokesReader* reader() const { return reader_; }
 
+    StrokesClock* clock() const { return clock_; }
+
+    // default use shared StrokesClock::instance(), set at start(), that
+    //  should be called on GUI thread then; change before start
+    void setClock(StrokesClock * clock);
+
 public:
     bool start();
 
@@ -30,19 +46,51 @@ public:
 
     void setMaxGap(int time); // adjust large gaps
 
+    bool isThreadedDecode() const { return threaded_; }
+
+    // decode async (streaming) data on worker thread, take once per frame
+    void setThreadedDecode(bool threaded);
+
+    qreal simplifyTolerance() const;
+
+    // drop stroke points closer than tolerance (stroke units), 0 to disable
+    //  see StrokeSimplifier::toleranceFor() for device pixels with zoom
+    void setSimplifyTolerance(qreal tolerance);
+
+    // spatial index of strokes added, null if not indexed
+    StrokesIndex * index() const { return index_; }
+
+    void setIndexed(bool indexed);
+
+    // redraw ink from index at level for tolerance, as after zoom changes
+    //  (StrokeSimplifier::toleranceFor()), without reading again
+    //  return false if not indexed
+    bool redrawIndexed(qreal tolerance);
+
+    // keep raster keyframes every interval (ms) under memory budget (bytes)
+    //  0 interval to disable, need subclass implement snapshots
+    void setCheckpoints(int interval, qint64 budget = 64 * 1024 * 1024);
+
     int time() const;
 
+    // known total duration from metadata, or played/seeked range
     int duration() const;
 
+    StrokesMetadata const & metadata() const { return meta_; }
+
+    // scan reader for metadata in background when it has none, default on;
+    //  off for renderers without event loop, the result comes by it
+    void setScanMetadata(bool scan) { scanMeta_ = scan; }
+
     void resume(); // start or resume
 
     void pause();
 
     void togglePlay(); // start/resume or pause
 
-    bool isStarted() const { return timer_; }
+    bool isStarted() const { return started_; }
 
-    bool isPlaying() const { return timer_ && !paused_ && !finished_; }
+    bool isPlaying() const { return started_ && !paused_ && !finished_; }
 
     bool isPaused() const { return paused_; }
 
@@ -62,6 +110,9 @@ protected:
 
     virtual void addPoint(StrokePoint const & point) = 0;
 
+    // points of current stroke, default call addPoint() one by one
+    virtual void addPoints(StrokePoint const * points, int count);
+
     virtual void endStroke() = 0;
 
     virtual void addNonStrokePoint(StrokePoint const & point) { (void) point; }
@@ -72,14 +123,38 @@ protected:
 
     virtual void onFinish() {}
 
+    // image of all ink added by now, return false if not available
+    virtual bool saveSnapshot(QImage & image) { (void) image; return false; }
+
+    // replace all ink with image, startStroke() follows if snapshot is in stroke
+    virtual void restoreSnapshot(QImage const & image) { (void) image; }
+
+    // remove all ink, before replaying from start
+    virtual void clearInk() {}
+
 protected:
     // time2 is adjust to the time of next point
     void seek(int time, int time2, int byte, bool inStroke);
 
+    // seek with reader index, not limited to read positions
+    //  if restartStroke, replay from start of stroke that is in progress at index
+    //  return false if reader is not indexed
+    bool seekToTime(int time, bool restartStroke = true);
+
+    // restore nearest earlier keyframe and replay only the delta
+    //  return false if no keyframe helps, then fallback to other seeks
+    bool seekToCheckpoint(int time);
+
     int t() const { return time_; }
 
     int b() const { return byte_; }
 
+private:
+    friend class StrokesClock;
+    friend class StrokesMixer; // drives other renderers as ink targets
+
+    int tickCount() const;
+
 private slots:
     void bump();
 
@@ -87,13 +162,35 @@ private slots:
 
     void stopAsync();
 
+    void drainAsync();
+
     void asyncFinished();
 
     void finish();
 
 private:
+    void saveMaxPosition();
+
+    void seekPlay(int time);
+
+    void seekIndex(int byte, bool inStroke);
+
+    void checkpoint();
+
+    void updateTime(StrokePoint const & point);
+
+    bool readPoint(StrokePoint & point);
+
+    void resetBatch();
+
+    void deliverPoint(StrokePoint const & point);
+
+    void flushPoints();
+
     void addPoint2(StrokePoint const & point);
 
+    void endStroke2();
+
 protected:
     StrokesReader* reader_;
     StrokePoint maximun_;
@@ -116,11 +213,29 @@ private:
     int notifyTime_ = 0;
     bool maxInStroke_ = false;
     bool asyncStarted_ = false;
+    bool threaded_ = false;
+    ThreadedStrokesDecoder * decoder_ = nullptr;
     float realRate_ = 0;
     int maxGap_ = 0;
+    StrokesMetadata meta_;
+    bool scanMeta_ = true;
+
+private:
+    // points read but not delivered, with position after each one
+    QVector<StrokePoint> batch_;
+    QVector<int> batchBytes_;
+    int batchSize_ = 0;
+    int batchPos_ = 0;
+    // run of in stroke points in batch_, to call addPoints()
+    int runStart_ = 0;
+    int runCount_ = 0;
 
 private:
-    QTimer *timer_ = nullptr;
+    StrokesClock * clock_ = nullptr;
+    bool started_ = false;
+    StrokesCheckpoints * checkpoints_ = nullptr;
+    StrokeSimplifier * simplifier_ = nullptr;
+    StrokesIndex * index_ = nullptr;
     float rate_ = 0;
     bool paused_ = false;
     /* this is real tick time
@@ -46,5 +46,6 @@ bool StrokesWriter::setMaximun(StrokePoint &point)
 
 void StrokesWriter::close()
 {
-    stream_->close();
+    if (stream_)
+        stream_->close();
 }
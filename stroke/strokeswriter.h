@@ -28,6 +28,9 @@ public:
 
     virtual bool write(StrokePoint & point) = 0;
 
+    // write points held by writer to stream, default write through
+    virtual bool flush() { return true; }
+
     virtual void close();
 
 protected:
@@ -0,0 +1,230 @@
+#include "threadedstrokesdecoder.h"
+#include "strokesreader.h"
+#include "spscringbuffer.h"
+#include "core/workthread.h"
+
+#include <QIODevice>
+
+#include <atomic>
+
+static constexpr int RING_SIZE = 16384; // points
+static constexpr qint64 MAX_BACKLOG = 1024 * 1024; // bytes not decoded
+static constexpr qint64 CHUNK = 64 * 1024;
+
+static WorkThread& thread()
+{
+    static WorkThread th("StrokesDecoder");
+    return th;
+}
+
+/*
+ * Raw data of source stream, used by reader on worker thread
+ *  position continues from source stream, consumed data is dropped
+ */
+class StreamPipe : public QIODevice
+{
+public:
+    StreamPipe(qint64 base)
+        : base_(base)
+    {
+        open(ReadOnly | Unbuffered);
+        seek(base);
+    }
+
+public:
+    void append(QByteArray const & data)
+    {
+        data_.append(data);
+    }
+
+    // drop consumed data, return size of consumed since last trim
+    qint64 trim()
+    {
+        qint64 consumed = pos() - base_;
+        if (consumed > data_.size())
+            consumed = data_.size();
+        data_.remove(0, static_cast<int>(consumed));
+        base_ += consumed;
+        return consumed;
+    }
+
+    virtual qint64 size() const override
+    {
+        return base_ + data_.size();
+    }
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxlen) override
+    {
+        qint64 off = pos() - base_;
+        if (off < 0)
+            return -1;
+        qint64 n = qMin(maxlen, data_.size() - off);
+        if (n <= 0)
+            return 0;
+        memcpy(data, data_.constData() + off, static_cast<size_t>(n));
+        return n;
+    }
+
+    virtual qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    qint64 base_;
+    QByteArray data_;
+};
+
+struct PointEntry
+{
+    StrokePoint point;
+    int bytePos;
+};
+
+struct ThreadedStrokesDecoder::State
+{
+    SpscRingBuffer<PointEntry> ring {RING_SIZE};
+    // only touched on worker thread
+    StrokesReader * reader = nullptr;
+    StreamPipe * pipe = nullptr;
+    bool inputFinished = false;
+    // shared
+    std::atomic<qint64> backlog {0};
+    std::atomic<bool> stalled {false};
+    std::atomic<bool> finished {false};
+};
+
+// on worker thread
+static void decode(QSharedPointer<ThreadedStrokesDecoder::State> const & state)
+{
+    if (state->reader == nullptr)
+        return;
+    PointEntry entry;
+    while (true) {
+        if (state->ring.isFull()) {
+            state->stalled = true;
+            break;
+        }
+        if (!state->reader->read(entry.point, entry.bytePos)) {
+            if (state->inputFinished || state->reader->atEnd())
+                state->finished = true;
+            break;
+        }
+        state->ring.push(entry);
+    }
+    state->backlog -= state->pipe->trim();
+}
+
+ThreadedStrokesDecoder::ThreadedStrokesDecoder(StrokesReader *reader, QObject *parent)
+    : QObject(parent)
+    , reader_(reader)
+{
+}
+
+ThreadedStrokesDecoder::~ThreadedStrokesDecoder()
+{
+    if (state_)
+        stop();
+}
+
+bool ThreadedStrokesDecoder::start()
+{
+    stream_ = reader_->stream_;
+    // sequential stream may have no data now, but not end
+    if (stream_ == nullptr || reader_->atEnd()
+            || (!stream_->isSequential() && stream_->atEnd()))
+        return false;
+    state_.reset(new State);
+    state_->reader = reader_;
+    state_->pipe = new StreamPipe(stream_->pos());
+    state_->pipe->moveToThread(&thread());
+    reader_->stream_ = state_->pipe;
+    connect(stream_, &QIODevice::readyRead, this, &ThreadedStrokesDecoder::pull);
+    connect(stream_, &QIODevice::readChannelFinished, this, [this] () {
+        sourceFinished_ = true;
+        pull();
+    });
+    pull();
+    return true;
+}
+
+int ThreadedStrokesDecoder::take(StrokePoint *points, int *bytePoses, int count)
+{
+    if (!state_)
+        return 0;
+    PointEntry entries[64];
+    int n = 0;
+    while (n < count) {
+        int m = state_->ring.pop(entries, qMin(64, count - n));
+        if (m == 0)
+            break;
+        for (int i = 0; i < m; ++i) {
+            points[n + i] = entries[i].point;
+            bytePoses[n + i] = entries[i].bytePos;
+        }
+        n += m;
+    }
+    if (state_->stalled.exchange(false)) {
+        QSharedPointer<State> state = state_;
+        thread().postWork([state] () {
+            decode(state);
+        });
+    }
+    pull();
+    return n;
+}
+
+bool ThreadedStrokesDecoder::isFinished() const
+{
+    return state_ && state_->finished && state_->ring.isEmpty();
+}
+
+void ThreadedStrokesDecoder::stop()
+{
+    if (!state_)
+        return;
+    stream_->disconnect(this);
+    QSharedPointer<State> state = state_;
+    // wait for pending decodes
+    thread().sendWork([state] () {
+        state->reader = nullptr;
+        delete state->pipe;
+        state->pipe = nullptr;
+    });
+    state_.reset();
+    reader_->stream_ = stream_;
+}
+
+void ThreadedStrokesDecoder::pull()
+{
+    if (!state_)
+        return;
+    while (state_->backlog < MAX_BACKLOG) {
+        QByteArray data = stream_->read(CHUNK);
+        if (data.isEmpty()) {
+            // file never signals readChannelFinished
+            if (!stream_->isSequential() && stream_->atEnd())
+                sourceFinished_ = true;
+            break;
+        }
+        state_->backlog += data.size();
+        QSharedPointer<State> state = state_;
+        thread().postWork([state, data] () {
+            if (state->pipe == nullptr)
+                return;
+            state->pipe->append(data);
+            decode(state);
+        });
+    }
+    if (sourceFinished_ && !finishPosted_ && stream_->bytesAvailable() == 0) {
+        finishPosted_ = true;
+        QSharedPointer<State> state = state_;
+        thread().postWork([state] () {
+            if (state->pipe == nullptr)
+                return;
+            state->inputFinished = true;
+            decode(state);
+        });
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef THREADEDSTROKESDECODER_H
+#define THREADEDSTROKESDECODER_H
+
+#include "ShowBoard_global.h"
+
+#include "strokepoint.h"
+
+#include <QObject>
+#include <QSharedPointer>
+
+class StrokesReader;
+class QIODevice;
+
+/*
+ * Decode stroke points of reader on worker thread
+ *  raw data is pulled from stream on owner thread, decoded points are pushed
+ *  into a bounded ring buffer, and taken by renderer once per frame
+ *  stream is not read when worker is behind, so memory is bounded
+ */
+
+class SHOWBOARD_EXPORT ThreadedStrokesDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    ThreadedStrokesDecoder(StrokesReader * reader, QObject * parent = nullptr);
+
+    virtual ~ThreadedStrokesDecoder() override;
+
+public:
+    // return false if reader is at end, or has no stream
+    bool start();
+
+    // take decoded points, bytePoses receive position after each point
+    int take(StrokePoint * points, int * bytePoses, int count);
+
+    // all points are taken
+    bool isFinished() const;
+
+    // give stream back to reader, reader is ahead of taken points, and
+    //  should be seeked before read again
+    void stop();
+
+public:
+    struct State;
+
+private:
+    void pull();
+
+private:
+    StrokesReader * reader_;
+    QIODevice * stream_ = nullptr;
+    QSharedPointer<State> state_;
+    bool sourceFinished_ = false;
+    bool finishPosted_ = false;
+};
+
+#endif // THREADEDSTROKESDECODER_H
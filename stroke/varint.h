@@ -0,0 +1,59 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <QByteArray>
+
+/*
+ * LEB128 varint and zigzag helpers, shared by compact stroke encodings
+ */
+
+static inline quint32 zigzag(int v)
+{
+    return (static_cast<quint32>(v) << 1) ^ static_cast<quint32>(v >> 31);
+}
+
+static inline int unzigzag(quint32 v)
+{
+    return static_cast<int>(v >> 1) ^ -static_cast<int>(v & 1);
+}
+
+// bits of a and b alternate, so two small values make one small value
+static inline quint32 interleave(quint32 a, quint32 b)
+{
+    quint32 v = 0;
+    for (int i = 0; i < 16; ++i)
+        v |= ((a >> i) & 1) << (2 * i) | ((b >> i) & 1) << (2 * i + 1);
+    return v;
+}
+
+static inline void deinterleave(quint32 v, quint32 & a, quint32 & b)
+{
+    a = b = 0;
+    for (int i = 0; i < 16; ++i) {
+        a |= ((v >> (2 * i)) & 1) << i;
+        b |= ((v >> (2 * i + 1)) & 1) << i;
+    }
+}
+
+static inline void putVarint(QByteArray & out, quint32 v)
+{
+    while (v >= 0x80) {
+        out.append(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.append(static_cast<char>(v));
+}
+
+static inline bool getVarint(uchar const *& p, uchar const * end, quint32 & v)
+{
+    v = 0;
+    for (int shift = 0; shift < 32 && p < end; shift += 7) {
+        uchar b = *p++;
+        v |= static_cast<quint32>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+#endif // VARINT_H
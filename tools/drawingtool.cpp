@@ -6,10 +6,12 @@
 #include "core/resourcetransform.h"
 #include "core/resourcepage.h"
 #include "views/canvasitem.h"
+#include "views/inkitem.h"
 
 #ifdef SHOWBOARD_QUICK
 #include <QQuickItem>
 #else
+#include <QGuiApplication>
 #include <QPen>
 #include <QPainter>
 #include <QGraphicsView>
@@ -17,6 +19,7 @@
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsProxyWidget>
 #include <QGraphicsScene>
+#include <QTouchEvent>
 #endif
 #include <QPushButton>
 #include <QHBoxLayout>
@@ -30,6 +33,11 @@ DrawingTool::DrawingTool(ResourceView *res)
 {
 }
 
+DrawingTool::~DrawingTool()
+{
+    setLowLatency(false);
+}
+
 QColor DrawingTool::color() const
 {
     return newSettings_.value("color", "write").value<QColor>();
@@ -87,6 +95,24 @@ void DrawingTool::setTranslucent(bool on)
 #endif
 }
 
+void DrawingTool::setLowLatency(bool on)
+{
+    if (on == lowLatency_)
+        return;
+    lowLatency_ = on;
+#ifdef SHOWBOARD_QUICK
+#else
+    // deliver every mouse move and touch update, not only the latest of a frame;
+    //  process wide, restore when turned off
+    if (on) {
+        compressEvents_ = QGuiApplication::testAttribute(Qt::AA_CompressHighFrequencyEvents);
+        QGuiApplication::setAttribute(Qt::AA_CompressHighFrequencyEvents, false);
+    } else {
+        QGuiApplication::setAttribute(Qt::AA_CompressHighFrequencyEvents, compressEvents_);
+    }
+#endif
+}
+
 class DrawingItem : public CanvasItem
 {
 public:
@@ -164,6 +190,8 @@ protected:
 
     virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override
     {
+        if (!touchInk_)
+            inkStart(event->pos(), event->timestamp());
         if (!control_) {
             DrawingTool * tool = static_cast<DrawingTool *>(Control::fromItem(this));
             control_ = tool->newControl();
@@ -176,12 +204,16 @@ protected:
 
     virtual void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override
     {
+        if (!touchInk_)
+            inkMove({event->pos()}, event->timestamp());
         if (control_)
             control_->event(event);
     }
 
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override
     {
+        if (!touchInk_)
+            inkEnd();
         if (control_) {
             inSetFocus_ = true; // avoid finish by lost focus
             control_->event(event);
@@ -210,6 +242,15 @@ protected:
 
     virtual bool sceneEvent(QEvent * event) override
     {
+        switch (event->type()) {
+        case QEvent::TouchBegin:
+        case QEvent::TouchUpdate:
+        case QEvent::TouchEnd:
+            inkTouch(static_cast<QTouchEvent *>(event));
+            break;
+        default:
+            break;
+        }
         if (event->type() == QEvent::FocusOut
                 || event->type() == QEvent::WindowDeactivate) {
             if (!inSetFocus_)
@@ -234,6 +275,93 @@ protected:
         return CanvasItem::itemChange(change, variant);
     }
 
+private:
+    // low latency ink, points go to live ink layer directly, the control
+    //  still gets events and takes over the stroke when it ends
+
+    // times are input event timestamps (ms), not when events are handled
+    bool inkStart(QPointF const & pos, ulong timestamp)
+    {
+        DrawingTool * tool = static_cast<DrawingTool *>(Control::fromItem(this));
+        if (!tool->lowLatency())
+            return false;
+        if (ink_ == nullptr) {
+            ink_ = new InkItem(this);
+            ink_->setImmediate(true);
+        }
+        ink_->setRect(rect());
+        QColor color = tool->color();
+        ink_->setPen(color.isValid() ? color : QColor(Qt::black), tool->width());
+        ink_->latency().reset();
+        ink_->latency().input();
+        lastTime_ = timestamp;
+        predictor_.reset();
+        predictor_.addPoint(pos, lastTime_);
+        ink_->startStroke(pos);
+        return true;
+    }
+
+    // points are coalesced input since last call, oldest first
+    void inkMove(QPolygonF const & points, ulong timestamp)
+    {
+        if (ink_ == nullptr || !ink_->surface().isDrawing() || points.isEmpty())
+            return;
+        ink_->latency().input();
+        qreal time = timestamp;
+        // spread coalesced points over time since last event
+        qreal step = (time - lastTime_) / points.size();
+        for (int i = 0; i < points.size(); ++i)
+            predictor_.addPoint(points[i], time - step * (points.size() - 1 - i));
+        lastTime_ = time;
+        ink_->addPoints(points, predictor_.predict());
+    }
+
+    void inkEnd()
+    {
+        if (ink_ == nullptr || !ink_->surface().isDrawing())
+            return;
+        ink_->cancelStroke();
+        InkLatency & latency = ink_->latency();
+        if (latency.count() > 0) {
+            DrawingTool * tool = static_cast<DrawingTool *>(Control::fromItem(this));
+            emit tool->latencyReported(latency.average(), latency.maximum());
+        }
+    }
+
+    void inkTouch(QTouchEvent * event)
+    {
+        if (event->touchPoints().isEmpty())
+            return;
+        QTouchEvent::TouchPoint const & point = event->touchPoints().first();
+        if (event->type() == QEvent::TouchBegin) {
+            touchInk_ = inkStart(point.pos(), event->timestamp());
+            return;
+        }
+        if (!touchInk_)
+            return;
+        if (event->type() == QEvent::TouchUpdate) {
+            QPolygonF points;
+            // raw positions are unfiltered history, in screen coordinates
+            QVector<QPointF> raws = point.rawScreenPositions();
+            QGraphicsView * view = scene()->views().isEmpty() ? nullptr : scene()->views().first();
+            if (raws.size() > 1 && view) {
+                // keep sub pixel precision, mapFromGlobal() takes QPoint only
+                QPointF origin = view->viewport()->mapToGlobal(QPoint());
+                QTransform toScene = view->viewportTransform().inverted();
+                for (QPointF const & raw : raws)
+                    points.append(mapFromScene(toScene.map(raw - origin)));
+                points.last() = point.pos();
+            } else {
+                points.append(point.pos());
+            }
+            inkMove(points, event->timestamp());
+        } else {
+            inkMove({point.pos()}, event->timestamp());
+            inkEnd();
+            touchInk_ = false;
+        }
+    }
+
 #endif
 
 private:
@@ -241,6 +369,13 @@ private:
     bool finish_ = false;
     bool inSetFocus_ = false;
     ControlView * finishItem_;
+#ifdef SHOWBOARD_QUICK
+#else
+    InkItem * ink_ = nullptr;
+    InkPredictor predictor_;
+    qreal lastTime_ = 0;
+    bool touchInk_ = false;
+#endif
 };
 
 ControlView *DrawingTool::create(ControlView *parent)
@@ -16,10 +16,13 @@ class DrawingTool : public Control
     Q_PROPERTY(bool translucent READ translucent WRITE setTranslucent)
     Q_PROPERTY(QColor color READ color WRITE setColor)
     Q_PROPERTY(qreal width READ width WRITE setWidth)
+    Q_PROPERTY(bool lowLatency READ lowLatency WRITE setLowLatency)
 
 public:
     Q_INVOKABLE DrawingTool(ResourceView *res);
 
+    virtual ~DrawingTool() override;
+
 public:
     QColor color() const;
 
@@ -40,11 +43,20 @@ public:
 
     void setTranslucent(bool on);
 
+    bool lowLatency() const { return lowLatency_; }
+
+    // draw strokes on live ink layer as input comes, with predicted tail
+    void setLowLatency(bool on);
+
 signals:
     void controlCreated(Control * control);
 
     void drawFinished(bool done);
 
+    // handler to pixel latency (ms) of last stroke in low latency mode, see
+    //  InkLatency
+    void latencyReported(qreal average, qreal maximum);
+
 private:
     virtual ControlView * create(ControlView * parent) override;
 
@@ -53,6 +65,8 @@ private:
 private:
     QUrl newUrl_;
     QVariantMap newSettings_;
+    bool lowLatency_ = false;
+    bool compressEvents_ = true; // app attribute before low latency
 };
 
 #endif // DRAWINGTOOL_H
@@ -0,0 +1,5 @@
+#ifdef SHOWBOARD_QUICK
+#include "quick/inkitemq.h"
+#else
+#include "graphics/inkitem.h"
+#endif
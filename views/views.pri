@@ -1,6 +1,7 @@
 HEADERS += \
     $$PWD/animcanvas.h \
     $$PWD/canvasitem.h \
+    $$PWD/inkitem.h \
     $$PWD/itemframe.h \
     $$PWD/itemselector.h \
     $$PWD/pagecanvas.h \